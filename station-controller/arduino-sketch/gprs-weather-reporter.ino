@@ -40,6 +40,16 @@
 
 #include "MStore_24LC1025.h"
 
+#include "TaskScheduler.h"
+
+#include "ReportWriter.h"
+
+#include "SensorPipeline.h"
+
+#include "EnergyCounters.h"
+
+#include "SpanTrace.h"
+
 
 
 // pins definition
@@ -60,19 +70,71 @@
 
 #define DEVICE_BATTERY_VOLTAGE_PIN A3
 
+#define RTC_INTERRUPT_PIN 2             // PCF8563 INT output (open drain) : not wired on the reference schematic (see RTC_INTERRUPT_WAKE_UP_ENABLED)
+#define RTC_INTERRUPT_NUMBER 0          // external interrupt INT0 <-> D2
+
 
 // TWI devices adresses
 
 #define EEPROM_STORE_ADDRESS 0x53       // A0 and A1 pins of the 24LC1025 chip tied to VCC
 
+#define RTC_ADDRESS 0x51
+
+
+// RTC (PCF8563) registers used for the timer wake-up
+
+#define RTC_CONTROL_STATUS_2_REGISTER 0x01          // bit 0 : TIE (timer interrupt enable), bit 2 : TF (timer flag)
+#define RTC_TIMER_CONTROL_REGISTER 0x0E             // bit 7 : TE (timer enable), bits 1-0 : TD (timer source clock)
+#define RTC_TIMER_REGISTER 0x0F                     // countdown value
+
+#define RTC_SECONDS_REGISTER 0x02                   // bit 7 : VL (voltage low : the integrity of the clock is not guaranteed)
+
+#define RTC_VOLTAGE_LOW_FLAG 0x80
+
+#define RTC_TIMER_FLAG 0x04                         // TF bit of the control / status 2 register
+
+#define RTC_TIMER_SOURCE_1_HZ 0x02
+#define RTC_TIMER_SOURCE_1_60_HZ 0x03
+
+
+// sleeping parameters :
+//
+// - RTC_INTERRUPT_WAKE_UP_ENABLED false : the sleeping time is counted with the watchdog (1 wake-up every second), the last seconds 
+//   are checked against the RTC
+// - RTC_INTERRUPT_WAKE_UP_ENABLED true : the MCU sleeps until the exact deadline, woken up by the PCF8563 timer (INT wired to RTC_INTERRUPT_PIN). 
+//   The watchdog also wakes it up every 8 s (RTC_TIMER_WATCHDOG_PERIOD_IN_S) : the timer flag is polled (INT not wired), and the sleep 
+//   ends once the expected time has passed, even if the timer never fires
+
+#define RTC_INTERRUPT_WAKE_UP_ENABLED false
+
+#define RTC_TIMER_WATCHDOG_PERIOD_IN_S 8
+
+
+// internal (ATmega) EEPROM map
+
+#define INTERNAL_EEPROM_DNS_CACHE_ADDRESS 0               // 32 bytes reserved for the GPRSbee DNS cache entry
+#define INTERNAL_EEPROM_MODEM_BAUD_RATE_ADDRESS 32        // 8 bytes reserved for the GPRSbee negotiated baud rate
+#define INTERNAL_EEPROM_ENERGY_COUNTERS_ADDRESS 40        // 26 bytes reserved for the energy counters
+#define INTERNAL_EEPROM_GPS_POSITION_ADDRESS 66           // 24 bytes reserved for the last known GPS position
+
+
+// fast start : when the RTC time can be trusted (PCF8563 VL flag cleared, time not earlier than the last known fix) and a position 
+// has been persisted, the station starts sampling at once after a reset : the first GPS acquisition and upload are left to the 
+// scheduler. Otherwise, the station loops on the GPS acquisition until a first fix sets the RTC
+
+#define FAST_START_ENABLED true
 
-// "undefined values" definition
 
-#define TEMPERATURE_UNDEFINED_VALUE -100.0
-#define HUMIDITY_UNDEFINED_VALUE -10.0
-#define PRESSURE_UNDEFINED_VALUE 0.0
-#define BATTERY_VOLTAGE_UNDEFINED_VALUE -1.0
-#define DEVICE_TEMPERATURE_UNDEFINED_VALUE -100.0
+// sensors sampling periods (seconds, aligned on the UTC clock) : a sensor which is not due leaves its report fields empty, so the 
+// periods must not exceed the reports period (300 s) unless empty fields are acceptable. The oversampled sensors (sampling period 
+// shorter than the reports period) report the mean of their samples since the previous report : only the cheap conversions are 
+// oversampled (BMP085 pressure : about 30 ms), the DHT22 (2 s powered warm-up) is sampled once per report
+
+#define TEMPERATURE_HUMIDITY_SAMPLING_PERIOD_IN_SECONDS 300
+#define PRESSURE_SAMPLING_PERIOD_IN_SECONDS 60
+#define GPS_POSITION_SAMPLING_PERIOD_IN_SECONDS 300
+#define DEVICE_TEMPERATURE_SAMPLING_PERIOD_IN_SECONDS 300
+#define BATTERY_VOLTAGE_SAMPLING_PERIOD_IN_SECONDS 300        // the power tier is updated with each battery reading
 
 
 // GPS acquisition parameters
@@ -81,6 +143,28 @@
 #define GPS_FIRST_ACQUISITION_HDOP_LIMIT 10
 #define GPS_ACQUISITION_TIMEOUT_IN_SECONDS 160
 #define GPS_ACQUISITION_HDOP_LIMIT 10
+#define GPS_ACQUISITION_MIN_NUM_OF_SATELLITES 5
+#define GPS_ACQUISITION_MIN_FIX_MODE GPS_FIX_MODE_3D
+#define GPS_ACQUISITION_PDOP_LIMIT 4
+
+#define GPS_AVERAGING_NUM_OF_FIXES 10                      // fixes averaged (HDOP weighting, outliers rejection) for each acquisition
+#define GPS_AVERAGING_WINDOW_IN_SECONDS 30                  // counted from the first fix
+#define GPS_AVERAGING_CONVERGENCE_RADIUS_IN_CM 300          // early exit as soon as a new fix moves the estimate by less than this radius
+
+#define GPS_SERIAL_LINK_BAUD_RATE 38400                   // requested to the receiver (PMTK251) once it has acknowledged its NMEA output mask
+#define GPS_UPDATE_PERIOD_IN_MS 1000
+
+#define GPS_STATIONARY_SITE_NUM_OF_FIXES 4                // consecutive fixes within the radius required to consider the site as stationary
+#define GPS_STATIONARY_SITE_RADIUS_IN_CM 2500
+#define GPS_STATIONARY_SITE_ACQUISITION_INTERVAL_IN_SECONDS 604800      // maintenance acquisitions only (once a week) at a stationary site
+
+#define GPS_BACKUP_MODE_ENABLED true                      // the receiver is kept in backup mode (PMTK225) between acquisitions instead of being powered off
+#define GPS_POSITION_AIDING_MAX_AGE_IN_SECONDS 604800     // the last fix is sent as a reference position (PMTK741) if it is less than a week old
+
+
+// modem serial link parameters
+
+#define MODEM_MAX_BAUD_RATE 38400                         // fastest rate reliably received by SoftwareSerial with an 8 MHz clock
 
 
 // GPRS connection parameters
@@ -96,16 +180,137 @@
 #define SERVER_PORT "80"   
 #define SERVER_POST_URL "your_post_url"
 
+#define SERVER_DNS_CACHE_TTL_IN_SECONDS 86400           // the server name is resolved (at most) once a day
+
+
+// backup server connection parameters (TCP upload transport only) : 
+//
+// when enabled, the modem is used in multi-connection mode and the connections to the primary and backup servers are opened at the same time
+//
+// - BACKUP_SERVER_POLICY_FIRST_CONNECTED : the reports are sent to the first server which accepts the connection
+// - BACKUP_SERVER_POLICY_ALL_CONNECTED : the reports are sent to all the servers which accept the connection, the first "200" response wins
+
+#define BACKUP_SERVER_ENABLED false
+
+#define BACKUP_SERVER_NAME "your_backup_server_name"
+#define BACKUP_SERVER_PORT "80"
+
+#define BACKUP_SERVER_POLICY_FIRST_CONNECTED 0
+#define BACKUP_SERVER_POLICY_ALL_CONNECTED 1
+
+#define BACKUP_SERVER_POLICY BACKUP_SERVER_POLICY_ALL_CONNECTED
+
+#define PRIMARY_SERVER_LINK 0
+#define BACKUP_SERVER_LINK 1
+
+#define MULTI_SERVER_CONNECT_TIMEOUT_IN_MS 30000
+#define MULTI_SERVER_RESPONSE_TIMEOUT_IN_MS 45000
+
+
+// upload transport : 
+//
+// - UPLOAD_TRANSPORT_TCP : the HTTP request is written "by hand" over a TCP connection (AT+CIPSTART / AT+CIPSEND)
+// - UPLOAD_TRANSPORT_HTTP_STACK : the modem's built-in HTTP stack is used (AT+HTTPDATA / AT+HTTPACTION), so that only the status code 
+//   of the response is transfered back over the serial link (the backlog is posted with several requests if its body cannot be input
+//   within the AT+HTTPDATA window at the current baud rate)
+
+#define UPLOAD_TRANSPORT_TCP 0
+#define UPLOAD_TRANSPORT_HTTP_STACK 1
+
+#define UPLOAD_TRANSPORT UPLOAD_TRANSPORT_TCP
+
+
+// upload policy : when UPLOAD_POLICY_BACKLOG_ENABLED is true, the modem is powered on by the send task only if the backlog of unsent 
+// reports reaches one of the thresholds (the counts are cached by the store), or if the oldest unsent report is too old. Otherwise 
+// the send task is skipped
+
+#define UPLOAD_POLICY_BACKLOG_ENABLED true
+
+#define UPLOAD_BACKLOG_MIN_NUM_OF_REPORTS 12
+#define UPLOAD_BACKLOG_MIN_NUM_OF_BYTES 1200
+#define UPLOAD_BACKLOG_MAX_AGE_IN_SECONDS 3600
+
 
 // station identifier
 
-#define STATION_ID "st01"                                    
+#define STATION_ID "st01"                                      // must not start with REPORT_RECORD_TYPE_PREFIX ('@', see ReportWriter.h)
 
 
-// report buffer length
+// report buffer length and format (PipeReportFormat, CSVReportFormat or JSONReportFormat, see ReportWriter.h)
 
 #define REPORT_BUFFER_LENGTH 124 
 
+#define REPORT_FORMAT PipeReportFormat
+
+#define REPORT_STATISTICS_FIELDS_ENABLED true           // min / max of the fields and samples count of the oversampled sensors (xx_min, xx_max, xx_n),
+                                                        // appended to the report (dropped if the report does not fit in the buffer)
+
+
+// urgent reports triggers : {field name, low limit, high limit, max change between two reports}, fixed-point values (e.g. 0.1 °C for
+// "t", see the fields definitions in SensorPipeline.cpp). The range is checked on the min / max of the oversampled fields, a trigger
+// fires when the value leaves the range (not while it stays out of it). An urgent report is uploaded as soon as it is stored (with 
+// the other urgent reports not sent yet), the other reports are kept for the next scheduled upload
+
+const FieldTrigger REPORT_TRIGGERS[] = {
+  
+  {"t", -100, 350, 30},                                                         // t < -10.0 or t > 35.0 (°C), or t changed by more than 3.0 °C
+  {"p", -FIELD_TRIGGER_NO_LIMIT, FIELD_TRIGGER_NO_LIMIT, 15}                    // p changed by more than 1.5 hPa (in 5 minutes)
+  
+};
+
+#define NUM_OF_REPORT_TRIGGERS (sizeof(REPORT_TRIGGERS) / sizeof(FieldTrigger))
+
+
+// energy accounting : on time counters (seconds, persisted in the EEPROM), with the average currents (mA) used for the charge estimate.
+// The counters and the estimated charge (q_mah) are appended to the daily health report
+
+#define ENERGY_COUNTER_MCU_AWAKE 0
+#define ENERGY_COUNTER_MODEM_ON 1
+#define ENERGY_COUNTER_GPS_ON 2
+#define ENERGY_COUNTER_SENSORS_ON 3
+#define ENERGY_COUNTER_I2C_BUSY 4
+
+#define NUM_OF_ENERGY_COUNTERS 5
+
+const char *ENERGY_COUNTERS_FIELDS_NAMES[NUM_OF_ENERGY_COUNTERS] = {"mcu_s", "mdm_s", "gps_s", "sns_s", "i2c_s"};
+
+const unsigned int ENERGY_COUNTERS_CURRENTS_IN_MA[NUM_OF_ENERGY_COUNTERS] = {4, 300, 25, 2, 3};
+
+#define ENERGY_COUNTERS_SAVE_PERIOD_IN_SECONDS 3600         // EEPROM writes : about 9000 / year
+
+#define HEALTH_REPORT_ENERGY_FIELDS_ENABLED true
+
+
+// spans tracing (only if SPAN_TRACE_ENABLED is true in SpanTrace.h) : the ring is exported before each scheduled upload, then cleared.
+// Dump : "event,start,duration" lines over the debug serial link. Upload : "trace" records ("@trace|id|ts|..." or {"rec":"trace",...}, 
+// see ReportWriter::addRecordType()), followed by (e, t, d) triplets 
+
+#define SPAN_TRACE_DUMP_ENABLED true
+#define SPAN_TRACE_UPLOAD_ENABLED false
+
+
+// power tiers : the tier is lowered as soon as the battery voltage falls below its minimum voltage, and raised back when the voltage
+// exceeds the minimum voltage of the upper tier plus the hysteresis (or simply reaches it while the battery is charging, i.e. while 
+// the voltage is rising). Intervals : the reports, uploads and GPS acquisitions deadlines are decimated (multiples of the periods of 
+// TASKS_SCHEDULES), 0 : task suspended
+
+#define POWER_TIER_NORMAL 0
+#define POWER_TIER_SAVING 1
+#define POWER_TIER_CRITICAL 2
+
+#define NUM_OF_POWER_TIERS 3
+
+const float POWER_TIERS_MIN_BATTERY_VOLTAGES[NUM_OF_POWER_TIERS] = {3.70, 3.55, 0.0};
+
+const unsigned long POWER_TIERS_REPORT_INTERVALS_IN_SECONDS[NUM_OF_POWER_TIERS] = {300, 300, 900};
+const unsigned long POWER_TIERS_UPLOAD_INTERVALS_IN_SECONDS[NUM_OF_POWER_TIERS] = {900, 3600, 21600};
+const unsigned long POWER_TIERS_GPS_INTERVALS_IN_SECONDS[NUM_OF_POWER_TIERS] = {21600, 0, 0};
+const boolean POWER_TIERS_OVERSAMPLING_ENABLED[NUM_OF_POWER_TIERS] = {true, false, false};
+const boolean POWER_TIERS_URGENT_UPLOADS_ENABLED[NUM_OF_POWER_TIERS] = {true, true, false};
+
+#define POWER_TIER_RECOVERY_HYSTERESIS 0.10                  // V
+#define BATTERY_CHARGING_MIN_VOLTAGE_RISE 0.02               // V, between two battery readings
+
 
 // tasks identifiers
 
@@ -113,19 +318,46 @@
 #define TASK_READ_SENSORS_AND_STORE_REPORT 1
 #define TASK_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF 2
 #define TASK_GPS_ACQUIRE_POSITION_POWER_ON_POWER_OFF 3
+#define TASK_SAMPLE_SENSORS 4
+#define TASK_STORE_HEALTH_REPORT 5
+
+
+// tasks schedules : {task ID, period, phase, max lateness} in seconds, deadlines aligned on the UTC clock (k * period + phase). 
+// A task has the priority over the following ones of the table when their deadlines are the same. The tasks due within 
+// TASKS_COALESCING_WINDOW_IN_SECONDS after the end of a task are executed in the same wake cycle : the phases order the tasks of a 
+// cycle (the reports are read before being sent, the GPS is powered on just after the hh:50 reading)
+
+const TaskSpec TASKS_SCHEDULES[] = {
+  
+  {TASK_READ_SENSORS_AND_STORE_REPORT, 300, 0, 60},                                   // every 5 minutes (hh:00:00, hh:05:00...)
+  {TASK_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF, 900, 10, 300},                  // every 15 minutes (hh:00:10, hh:15:10...)
+  {TASK_GPS_ACQUIRE_POSITION_POWER_ON_POWER_OFF, 21600, 6610, 3600},                  // every 6 hours (01:50:10, 07:50:10, 13:50:10, 19:50:10)
+  {TASK_SAMPLE_SENSORS, 60, 0, 30},                                                   // every minute (oversampled sensors, see the sampling periods)
+  {TASK_STORE_HEALTH_REPORT, 86400, 420, 3600}                                        // every day (00:07:00)
+  
+};
+
+#define TASKS_COALESCING_WINDOW_IN_SECONDS 30
+
+#define SCHEDULER_RTC_ADJUSTMENT_TOLERANCE_IN_SECONDS 30      // the deadlines are recomputed when the GPS corrects the RTC by more than this
 
 
 // calibration data
 
 #define ADC_REF_VOLTAGE 3.3
 
+#define BATTERY_VOLTAGE_DIVIDER_RATIO (156.0 / 56.0)
+
 
 
 
 SoftwareSerial softSerialDebug(DEBUG_RX_PIN, DEBUG_TX_PIN); 
 
 
-GPRSbee modem(MODEM_POWER_PIN, MODEM_STATUS_PIN, MODEM_RX_PIN, MODEM_TX_PIN, &softSerialDebug);
+SoftwareSerial softSerialModem(MODEM_RX_PIN, MODEM_TX_PIN);
+
+
+GPRSbee modem(MODEM_POWER_PIN, MODEM_STATUS_PIN, &softSerialModem, &softSerialDebug);
 
 
 UltimateGPS gps(&Serial, GPS_POWER_PIN, &softSerialDebug);
@@ -137,16 +369,77 @@ MStore_24LC1025 mStore(EEPROM_STORE_ADDRESS);
 Rtc_Pcf8563 rtc;
 
 
+TaskScheduler scheduler;
+
+
 dht temperatureHumiditySensor;
 
 
 Adafruit_BMP085 pressureSensor;
 
 
+DHT22Sensor temperatureHumidityPipelinedSensor(&temperatureHumiditySensor, TEMPERATURE_HUMIDITY_SENSOR_DATA_PIN, SENSORS_POWER_PIN);
+
+BMP085PressureSensor pressurePipelinedSensor(&pressureSensor);
+
+BMP085TemperatureSensor deviceTemperaturePipelinedSensor(&pressureSensor);
+
+GPSPositionSensor gpsPositionPipelinedSensor(&gps, getTimeStamp);
+
+AnalogVoltageSensor batteryVoltagePipelinedSensor(DEVICE_BATTERY_VOLTAGE_PIN, 10, ADC_REF_VOLTAGE * BATTERY_VOLTAGE_DIVIDER_RATIO / 1024);
+
+SensorPipeline sensorPipeline;
+
+
+EnergyCounters energyCounters;
+
+
 byte nextTaskID = TASK_NONE;
 
 unsigned long nextTaskTimestamp = 0;
 
+unsigned long nextWakeTimestamp = 0;                                 // nextTaskTimestamp, or earlier if the task is coalesced
+
+boolean rtcTimeSet = false;
+
+boolean rtcAdjusted = false;
+
+unsigned long lastFixTimestamp = 0;
+
+long fixHistoryLatitudes[GPS_STATIONARY_SITE_NUM_OF_FIXES];          // micro-degrees
+
+long fixHistoryLongitudes[GPS_STATIONARY_SITE_NUM_OF_FIXES];
+
+byte fixHistoryNumOfFixes = 0;
+
+boolean stationarySite = false;
+
+volatile boolean rtcInterruptReceived = false;
+
+long triggersLastValues[NUM_OF_REPORT_TRIGGERS];
+
+boolean triggersLastValuesAvailable[NUM_OF_REPORT_TRIGGERS];
+
+boolean triggersOutOfRange[NUM_OF_REPORT_TRIGGERS];
+
+boolean urgentReportStored = false;
+
+unsigned long energyCountersSaveTimestamp = 0;
+
+float batteryVoltage = 0.0;                                          // last reading, 0.0 if unknown
+
+byte powerTier = POWER_TIER_NORMAL;
+
+boolean powerTierRaised = false;
+
+unsigned long lastReportDeadline = 0;
+
+unsigned long lastUploadDeadline = 0;
+
+unsigned long lastGPSAcquisitionDeadline = 0;
+
+unsigned long oldestUnsentReportTimestamp = 0;                       // 0 : no unsent report
+
 
 
 
@@ -168,11 +461,40 @@ void setup()  {
   
   gps.init(9600);
   
+  gps.setAcquisitionCriteria(GPS_ACQUISITION_MIN_FIX_MODE, GPS_ACQUISITION_PDOP_LIMIT);
+  
   modem.init(9600);
+  
+  modem.enableBaudRateNegotiation(MODEM_MAX_BAUD_RATE, INTERNAL_EEPROM_MODEM_BAUD_RATE_ADDRESS);
+  
+  modem.enableDNSCache(INTERNAL_EEPROM_DNS_CACHE_ADDRESS, SERVER_DNS_CACHE_TTL_IN_SECONDS);
+  
+  energyCounters.init(NUM_OF_ENERGY_COUNTERS, INTERNAL_EEPROM_ENERGY_COUNTERS_ADDRESS);
+  
+  scheduler.addTasks(TASKS_SCHEDULES, sizeof(TASKS_SCHEDULES) / sizeof(TaskSpec));
+  
+  scheduler.setCoalescingWindow(TASKS_COALESCING_WINDOW_IN_SECONDS);
 
   Wire.begin();
   
+  if(RTC_INTERRUPT_WAKE_UP_ENABLED) {
+    
+    pinMode(RTC_INTERRUPT_PIN, INPUT_PULLUP);
+    
+    stopRtcTimer();
+    
+  }
+  
   pressureSensor.begin(); 
+  
+  // sensors registry : the report fields (after "id" and "ts") are those of the sensors, in the order of registration. The slowest 
+  // sensor (warm-up) is registered first, so that it is started first
+  
+  sensorPipeline.addSensor(&temperatureHumidityPipelinedSensor, TEMPERATURE_HUMIDITY_SAMPLING_PERIOD_IN_SECONDS);            // t, h (one sample per report : no statistics)
+  sensorPipeline.addSensor(&pressurePipelinedSensor, PRESSURE_SAMPLING_PERIOD_IN_SECONDS, true);                             // p (statistics)
+  sensorPipeline.addSensor(&gpsPositionPipelinedSensor, GPS_POSITION_SAMPLING_PERIOD_IN_SECONDS);                            // fix_ts, lat, lon, alt
+  sensorPipeline.addSensor(&deviceTemperaturePipelinedSensor, DEVICE_TEMPERATURE_SAMPLING_PERIOD_IN_SECONDS);                // dev_t
+  sensorPipeline.addSensor(&batteryVoltagePipelinedSensor, BATTERY_VOLTAGE_SAMPLING_PERIOD_IN_SECONDS);                      // bat
 
   mStore.init();
 
@@ -184,35 +506,55 @@ void setup()  {
   
   
   boolean taskSuccess;
-    
-  taskSuccess = modemPowerOn_httpPostStoredReports_modemPowerOff(1024);
   
+  boolean fastStart = false;
   
+  if(FAST_START_ENABLED and gps.restorePosition(INTERNAL_EEPROM_GPS_POSITION_ADDRESS)) fastStart = isRtcTimeTrustworthy();
   
-  boolean firstPositionAcquired = false;
+  if(fastStart) {
+    
+    rtcTimeSet = true;
+    
+    lastFixTimestamp = getTimeStamp(gps.position.fix_Y_utc, gps.position.fix_M_utc, gps.position.fix_D_utc, gps.position.fix_h_utc, gps.position.fix_m_utc, gps.position.fix_s_utc);
+    
+  }
   
-  while(1) {
+  else {
     
-    firstPositionAcquired = acquireCurrentPosition_gpsOnOff(GPS_FIRST_ACQUISITION_HDOP_LIMIT, GPS_FIRST_ACQUISITION_TIMEOUT_IN_SECONDS);
+    taskSuccess = modemPowerOn_httpPostStoredReports_modemPowerOff(1024, false);
     
-    if(firstPositionAcquired) {
-      break;
-    }
+    boolean firstPositionAcquired = false;
     
-    else sleepSeconds(120);
+    while(1) {
+      
+      firstPositionAcquired = acquireCurrentPosition_gpsOnOff(GPS_FIRST_ACQUISITION_HDOP_LIMIT, GPS_FIRST_ACQUISITION_TIMEOUT_IN_SECONDS);
+      
+      if(firstPositionAcquired) {
+        break;
+      }
+      
+      else sleepSeconds(120);
+      
+    }
     
   }
  
   // Notes :
   //
   // - the RTC date and time are automatically updated, with the help of the GPS module, at each new position acquisition
-  // - we suppose here that the RTC is in an unknown state at the beginning of the sketch, so we need to set the correct date / time a first time by acquiring the position of the station
+  // - without a fast start, we suppose here that the RTC is in an unknown state at the beginning of the sketch, so we need to set the correct date / time a first time by acquiring the position of the station
   // - this is why we go here in a loop until we get a first position : this should not be a problem when the station is used outdoor
   
 
   taskSuccess = readSensorsAndStoreReport();
   
-  taskSuccess = modemPowerOn_httpPostStoredReports_modemPowerOff(1024);
+  if(!fastStart) taskSuccess = modemPowerOn_httpPostStoredReports_modemPowerOff(1024, false);
+  
+  scheduler.start(getTimeStampNow());
+  
+  rtcAdjusted = false;
+  
+  urgentReportStored = false;
   
 }
 
@@ -250,6 +592,181 @@ void sleepSeconds(unsigned long seconds) {
 
 
 
+void sleepUntil(unsigned long timestamp) {
+  
+  unsigned long timestampNow = getTimeStampNow();
+  
+  if(!RTC_INTERRUPT_WAKE_UP_ENABLED) {
+    
+    if(timestamp > timestampNow) sleepSeconds(timestamp - timestampNow);
+    
+    // the watchdog period is not accurate : the remaining seconds, if any, are counted one by one with the RTC
+    
+    timestampNow = getTimeStampNow();
+    
+    while((timestampNow > 0) and (timestampNow < timestamp)) {
+      
+      sleepSeconds(1);
+      
+      timestampNow = getTimeStampNow();
+      
+    }
+    
+    return;
+    
+  }
+  
+  while(timestampNow < timestamp) {
+    
+    unsigned long remainingSeconds = timestamp - timestampNow;
+    
+    boolean rtcTimerStarted;
+    
+    if(remainingSeconds > 180) {
+      
+      // the first period of the 1/60 Hz source can be shortened : one minute is kept in reserve, the remaining seconds are then 
+      // counted with the 1 Hz source
+      
+      unsigned long minutes = remainingSeconds / 60 - 1;
+      
+      if(minutes > 255) minutes = 255;
+      
+      rtcTimerStarted = sleepRtcTimer(RTC_TIMER_SOURCE_1_60_HZ, minutes);
+      
+    }
+    
+    else rtcTimerStarted = sleepRtcTimer(RTC_TIMER_SOURCE_1_HZ, remainingSeconds);
+    
+    if(!rtcTimerStarted) {
+      
+      sleepSeconds(remainingSeconds);             // fallback : RTC not reachable
+      
+      break;
+      
+    }
+    
+    timestampNow = getTimeStampNow();
+    
+  }
+  
+}
+
+
+
+boolean sleepRtcTimer(byte timerSource, byte timerCount) {
+  
+  // power down sleep until the PCF8563 timer fires : INT output pulled low (if wired), or TF polled at each watchdog wake-up. 
+  // The sleep also ends once the expected time has passed (RTC time or watchdog periods count), whether the timer has fired 
+  // or not. Returns false if the timer could not be started
+  
+  writeRtcRegister(RTC_TIMER_CONTROL_REGISTER, RTC_TIMER_SOURCE_1_60_HZ);            // timer disabled
+  writeRtcRegister(RTC_TIMER_REGISTER, timerCount);
+  writeRtcRegister(RTC_CONTROL_STATUS_2_REGISTER, 0x01);                             // TIE set, TF cleared
+  writeRtcRegister(RTC_TIMER_CONTROL_REGISTER, 0x80 | timerSource);                  // timer enabled
+  
+  if((readRtcRegister(RTC_TIMER_CONTROL_REGISTER) & 0x83) != (0x80 | timerSource)) {
+    
+    stopRtcTimer();
+    
+    return false;
+    
+  }
+  
+  unsigned long expectedSleepingTimeInS = (timerSource == RTC_TIMER_SOURCE_1_HZ) ? timerCount : (unsigned long) timerCount * 60;
+  
+  unsigned long wakeUpTimestamp = getTimeStampNow() + expectedSleepingTimeInS;
+  
+  unsigned long watchdogSleepingTimeInS = 0;
+  
+  rtcInterruptReceived = false;
+  
+  attachInterrupt(RTC_INTERRUPT_NUMBER, rtcInterruptHandler, LOW);                   // only a level interrupt wakes the MCU up from power down
+  
+  while(!rtcInterruptReceived) {
+    
+    LowPower.powerDown(SLEEP_8S, ADC_OFF, BOD_OFF);
+    
+    if(rtcInterruptReceived) break;
+    
+    watchdogSleepingTimeInS += RTC_TIMER_WATCHDOG_PERIOD_IN_S;
+    
+    if(readRtcRegister(RTC_CONTROL_STATUS_2_REGISTER) & RTC_TIMER_FLAG) break;
+    
+    if(getTimeStampNow() >= wakeUpTimestamp) break;
+    
+    if(watchdogSleepingTimeInS >= expectedSleepingTimeInS + RTC_TIMER_WATCHDOG_PERIOD_IN_S) break;         // RTC not counting
+    
+  }
+  
+  detachInterrupt(RTC_INTERRUPT_NUMBER);
+  
+  stopRtcTimer();
+  
+  return true;
+  
+}
+
+
+
+void rtcInterruptHandler() {
+  
+  detachInterrupt(RTC_INTERRUPT_NUMBER);                // INT stays low until TF is cleared
+  
+  rtcInterruptReceived = true;
+  
+}
+
+
+
+void stopRtcTimer() {
+  
+  writeRtcRegister(RTC_TIMER_CONTROL_REGISTER, RTC_TIMER_SOURCE_1_60_HZ);            // timer disabled, lowest power source selected
+  writeRtcRegister(RTC_CONTROL_STATUS_2_REGISTER, 0x00);                             // TIE and TF cleared : INT released
+  
+}
+
+
+
+boolean isRtcTimeTrustworthy() {
+  
+  // the VL flag is set by the PCF8563 when its supply has dropped too low (battery swap...), and cleared when the time is set (the 
+  // seconds register is written) : the RTC time must also not be earlier than the fix date / time of the last known position
+  
+  if(readRtcRegister(RTC_SECONDS_REGISTER) & RTC_VOLTAGE_LOW_FLAG) return false;
+  
+  unsigned long fixTimestamp = getTimeStamp(gps.position.fix_Y_utc, gps.position.fix_M_utc, gps.position.fix_D_utc, gps.position.fix_h_utc, gps.position.fix_m_utc, gps.position.fix_s_utc);
+  
+  return (getTimeStampNow() >= fixTimestamp);
+  
+}
+
+
+
+void writeRtcRegister(byte registerAddress, byte value) {
+  
+  Wire.beginTransmission(RTC_ADDRESS);
+  Wire.write(registerAddress);
+  Wire.write(value);
+  Wire.endTransmission();
+  
+}
+
+
+
+byte readRtcRegister(byte registerAddress) {
+  
+  Wire.beginTransmission(RTC_ADDRESS);
+  Wire.write(registerAddress);
+  Wire.endTransmission();
+  
+  Wire.requestFrom(RTC_ADDRESS, 1);
+  
+  return Wire.read();
+  
+}
+
+
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // Time & tasks management 
@@ -308,135 +825,204 @@ unsigned long getTimeStampNow() {
 
 void scheduleNextTaskAndSleep() {
   
-  unsigned long timestampNow = 0;
+  unsigned long timestampNow = getTimeStampNow();
   
-  rtc.getDate();
-  rtc.getTime();
+  if(timestampNow < lastFixTimestamp) {
+    
+    // the RTC has gone back in time (RTC reset) : back to the normal GPS acquisition cadence, and all the deadlines are recomputed
+    
+    stationarySite = false;
+    fixHistoryNumOfFixes = 0;
+    
+    scheduler.start(timestampNow);
+    
+  }
   
-  byte Y_now = rtc.getYear();
-  byte M_now = rtc.getMonth();
-  byte D_now = rtc.getDay();
-  byte h_now = rtc.getHour();
-  byte m_now = rtc.getMinute();
-  byte s_now = rtc.getSecond();
+  nextTaskID = scheduler.getNextTaskID(timestampNow);
   
-  timestampNow = getTimeStamp(Y_now, M_now, D_now, h_now, m_now, s_now);
+  nextTaskTimestamp = scheduler.getNextTaskTimestamp();
   
+  nextWakeTimestamp = scheduler.getNextWakeTimestamp(timestampNow);
   
-  // when will the next READ_SENSORS_AND_STORE_REPORT task occur ?         
-
-  unsigned long nextTASK_READ_SENSORS_AND_STORE_REPORT_timestamp;
+  sleepUntil(nextWakeTimestamp);
   
-  byte minutes_READ_SENSORS_AND_STORE_REPORT[12] = {0, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50, 55};
+}
 
-  byte second_READ_SENSORS_AND_STORE_REPORT = 0;
+
+
+void executeScheduledTask() {
+  
+  boolean success = false;
   
-  nextTASK_READ_SENSORS_AND_STORE_REPORT_timestamp = getTimeStamp(Y_now, M_now, D_now, h_now, minutes_READ_SENSORS_AND_STORE_REPORT[0], second_READ_SENSORS_AND_STORE_REPORT) + 3600 ;
+  unsigned long timestampNow = getTimeStampNow();          // sleepUntil() has returned at nextWakeTimestamp (or later)
   
-  for(char i = sizeof(minutes_READ_SENSORS_AND_STORE_REPORT) - 1 ; i>=0 ; i--) {
+  TRACE_SPAN_VARIABLE(taskStartMS);
+  TRACE_SPAN_BEGIN(taskStartMS);
+  
+  if(nextTaskID == TASK_READ_SENSORS_AND_STORE_REPORT) {
     
-    if((m_now < minutes_READ_SENSORS_AND_STORE_REPORT[i]) or ((m_now == minutes_READ_SENSORS_AND_STORE_REPORT[i]) and (s_now < second_READ_SENSORS_AND_STORE_REPORT))) {
-      nextTASK_READ_SENSORS_AND_STORE_REPORT_timestamp = getTimeStamp(Y_now, M_now, D_now, h_now, minutes_READ_SENSORS_AND_STORE_REPORT[i], second_READ_SENSORS_AND_STORE_REPORT);
+    lastReportDeadline = nextTaskTimestamp;
+    
+    success = readSensorsAndStoreReport();
+    
+    if(urgentReportStored and POWER_TIERS_URGENT_UPLOADS_ENABLED[powerTier]) {
+      
+      modemPowerOn_httpPostStoredReports_modemPowerOff(1024, true);          // urgent reports only (if it fails, they will be sent with the others)
+      
+      urgentReportStored = false;
+      
     }
-  
+    
   }
   
+  else if(nextTaskID == TASK_STORE_HEALTH_REPORT) {
+    
+    success = storeHealthReport();
+    
+  }
   
-  // when will the next SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF task occur ?     
-  
-  unsigned long nextTASK_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF_timestamp;
+  else if(nextTaskID == TASK_SAMPLE_SENSORS) {
+    
+    sensorPipeline.sample(timestampNow);
+    
+    success = true;
+    
+  }
   
-  byte minutes_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF[4] = {0, 15, 30, 45};
+  else if(nextTaskID == TASK_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF) {
+    
+    lastUploadDeadline = nextTaskTimestamp;
+    
+#if SPAN_TRACE_ENABLED
+    
+    exportSpanTrace();
+    
+#endif
+    
+    if(!UPLOAD_POLICY_BACKLOG_ENABLED or isUploadDue(timestampNow)) success = modemPowerOn_httpPostStoredReports_modemPowerOff(1024, false);
+    else success = true;
+    
+  }
   
-  byte second_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF = 10;
+  else if(nextTaskID == TASK_GPS_ACQUIRE_POSITION_POWER_ON_POWER_OFF) {
+    
+    lastGPSAcquisitionDeadline = nextTaskTimestamp;
+    
+    success = acquireCurrentPosition_gpsOnOff(GPS_ACQUISITION_HDOP_LIMIT, GPS_ACQUISITION_TIMEOUT_IN_SECONDS);
+    
+  }
   
-  nextTASK_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF_timestamp = getTimeStamp(Y_now, M_now, D_now, h_now, minutes_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF[0], second_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF) + 3600 ;
+  TRACE_SPAN_END(TRACE_EVENT_TASK + nextTaskID, taskStartMS);
   
-  for(char i = sizeof(minutes_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF) - 1 ; i>=0 ; i--) {
-    
-    if((m_now < minutes_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF[i]) or ((m_now == minutes_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF[i]) and (s_now < second_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF))) {
-      nextTASK_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF_timestamp = getTimeStamp(Y_now, M_now, D_now, h_now, minutes_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF[i], second_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF);
-    }
+  timestampNow = getTimeStampNow();
   
-  }
+  // the age of the oldest unsent report is counted from the end of the first task after which the store is no more empty (after a 
+  // partial upload, the reports left are considered as old as the oldest report of the backlog)
   
+  if(mStore.getMessagesCount() == 0) oldestUnsentReportTimestamp = 0;
+  else if(oldestUnsentReportTimestamp == 0) oldestUnsentReportTimestamp = timestampNow;
   
-  // when will the next GPS_ACQUIRE_POSITION task occur ?      
-
-  unsigned long nextTask_GPS_ACQUIRE_POSITION_timestamp;
+  updateEnergyCounters();
   
-  byte hours_GPS_ACQUIRE_POSITION[4] = {1, 7, 13, 19};
-  byte minute_GPS_ACQUIRE_POSITION = 52;
-
-  nextTask_GPS_ACQUIRE_POSITION_timestamp = getTimeStamp(Y_now, M_now, D_now, hours_GPS_ACQUIRE_POSITION[0], minute_GPS_ACQUIRE_POSITION, 0) + 86400 ;
-
-  for(char i = sizeof(hours_GPS_ACQUIRE_POSITION) - 1 ; i>=0 ; i--) {
+  if((timestampNow - energyCountersSaveTimestamp) >= ENERGY_COUNTERS_SAVE_PERIOD_IN_SECONDS) {
+    
+    energyCounters.save();
+    
+    energyCountersSaveTimestamp = timestampNow;
     
-    if((h_now < hours_GPS_ACQUIRE_POSITION[i]) or ((h_now == hours_GPS_ACQUIRE_POSITION[i]) and (m_now < minute_GPS_ACQUIRE_POSITION))) {
-      nextTask_GPS_ACQUIRE_POSITION_timestamp = getTimeStamp(Y_now, M_now, D_now, hours_GPS_ACQUIRE_POSITION[i], minute_GPS_ACQUIRE_POSITION, 0);
-    }
-  
   }
   
- 
-  // which is the priority task between READ_SENSORS_AND_STORE_REPORT, SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF and GPS_ACQUIRE_POSITION ? 
-  
-  nextTaskTimestamp = nextTASK_READ_SENSORS_AND_STORE_REPORT_timestamp;
-  nextTaskID = TASK_READ_SENSORS_AND_STORE_REPORT;
+  scheduler.taskExecuted(timestampNow);
   
-  if(nextTASK_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF_timestamp < nextTaskTimestamp) {
+  if(rtcAdjusted or powerTierRaised) {
     
-    nextTaskTimestamp = nextTASK_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF_timestamp;
-    nextTaskID = TASK_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF;
+    scheduler.start(timestampNow);                // the deadlines suspended or decimated by a lower tier are restored as well
+    
+    rtcAdjusted = false;
+    powerTierRaised = false;
     
   }
   
-  if(nextTask_GPS_ACQUIRE_POSITION_timestamp < nextTaskTimestamp) {
+  applyPowerTier(timestampNow);
+  
+  if(stationarySite) {
     
-    nextTaskTimestamp = nextTask_GPS_ACQUIRE_POSITION_timestamp;
-    nextTaskID = TASK_GPS_ACQUIRE_POSITION_POWER_ON_POWER_OFF;
+    scheduler.postponeTask(TASK_GPS_ACQUIRE_POSITION_POWER_ON_POWER_OFF, lastFixTimestamp + GPS_STATIONARY_SITE_ACQUISITION_INTERVAL_IN_SECONDS);   // maintenance acquisitions only
     
   }
   
+}
+
+
+
+boolean isUploadDue(unsigned long timestampNow) {
+  
+  if(mStore.getMessagesCount() >= UPLOAD_BACKLOG_MIN_NUM_OF_REPORTS) return true;
   
-  sleepSeconds(nextTaskTimestamp - timestampNow);
+  if(mStore.getMessagesBytesCount() >= UPLOAD_BACKLOG_MIN_NUM_OF_BYTES) return true;
+  
+  if((oldestUnsentReportTimestamp != 0) and ((timestampNow - oldestUnsentReportTimestamp) >= UPLOAD_BACKLOG_MAX_AGE_IN_SECONDS)) return true;
+  
+  return false;
   
 }
 
 
 
-void executeScheduledTask() {
+void updatePowerTier(float newBatteryVoltage) {
   
-  boolean success = false;
+  // lowered at once (possibly by several tiers), raised one tier at a time
   
-  unsigned long timestampNow = getTimeStampNow();
- 
-  while((timestampNow > 0) and (timestampNow < nextTaskTimestamp)) {
-   
-    sleepSeconds(1);  
+  boolean charging = (batteryVoltage > 0.0) and (newBatteryVoltage >= (batteryVoltage + BATTERY_CHARGING_MIN_VOLTAGE_RISE));
+  
+  batteryVoltage = newBatteryVoltage;
+  
+  while((powerTier < (NUM_OF_POWER_TIERS - 1)) and (batteryVoltage < POWER_TIERS_MIN_BATTERY_VOLTAGES[powerTier])) powerTier++;
+  
+  if(powerTier > POWER_TIER_NORMAL) {
     
-    timestampNow = getTimeStampNow();
+    float recoveryVoltage = POWER_TIERS_MIN_BATTERY_VOLTAGES[powerTier - 1];
     
-  }
-  
-  if(nextTaskID == TASK_READ_SENSORS_AND_STORE_REPORT) {
+    if(!charging) recoveryVoltage += POWER_TIER_RECOVERY_HYSTERESIS;
     
-    success = readSensorsAndStoreReport();
+    if(batteryVoltage >= recoveryVoltage) {
+      
+      powerTier--;
+      
+      powerTierRaised = true;
+      
+    }
     
   }
   
-  else if(nextTaskID == TASK_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF) {
+}
+
+
+
+void applyPowerTier(unsigned long timestampNow) {
+  
+  // the tasks are postponed to the first deadline after their last execution plus the interval of the current tier (never advanced)
+  
+  scheduler.postponeTask(TASK_READ_SENSORS_AND_STORE_REPORT, lastReportDeadline + POWER_TIERS_REPORT_INTERVALS_IN_SECONDS[powerTier]);
+  
+  if(POWER_TIERS_UPLOAD_INTERVALS_IN_SECONDS[powerTier] > 0) {
     
-    success = modemPowerOn_httpPostStoredReports_modemPowerOff(1024);
+    scheduler.postponeTask(TASK_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF, lastUploadDeadline + POWER_TIERS_UPLOAD_INTERVALS_IN_SECONDS[powerTier]);
     
   }
   
-  else if(nextTaskID == TASK_GPS_ACQUIRE_POSITION_POWER_ON_POWER_OFF) {
+  else scheduler.postponeTask(TASK_SEND_STORED_REPORTS_MODEM_POWER_ON_POWER_OFF, timestampNow + 86400);
+  
+  if(POWER_TIERS_GPS_INTERVALS_IN_SECONDS[powerTier] > 0) {
     
-    success = acquireCurrentPosition_gpsOnOff(GPS_ACQUISITION_HDOP_LIMIT, GPS_ACQUISITION_TIMEOUT_IN_SECONDS);
+    scheduler.postponeTask(TASK_GPS_ACQUIRE_POSITION_POWER_ON_POWER_OFF, lastGPSAcquisitionDeadline + POWER_TIERS_GPS_INTERVALS_IN_SECONDS[powerTier]);
     
   }
   
+  else scheduler.postponeTask(TASK_GPS_ACQUIRE_POSITION_POWER_ON_POWER_OFF, timestampNow + 86400);        // re-evaluated after each task
+  
+  if(!POWER_TIERS_OVERSAMPLING_ENABLED[powerTier]) scheduler.postponeTask(TASK_SAMPLE_SENSORS, timestampNow + 86400);
+  
 }
 
 
@@ -455,18 +1041,64 @@ boolean acquireCurrentPosition_gpsOnOff(float accuracyLimit, int timeoutInS) {
   
   gps.powerOn();
   
-  gps.configure();
+  gps.configure(GPS_NMEA_OUTPUT_DEFAULT_MASK | GPS_NMEA_OUTPUT_GSA, GPS_SERIAL_LINK_BAUD_RATE, GPS_UPDATE_PERIOD_IN_MS);         // GGA, RMC and GSA (fix mode, PDOP) sentences only
   
-  positionAcquired = gps.acquireNewPosition(accuracyLimit, timeoutInS);
+  if(rtcTimeSet) {
+    
+    // assisted start : the RTC time and the last fix are sent to the receiver, so that it does not have to search the whole sky
+    
+    rtc.getDate();
+    rtc.getTime();
+    
+    byte Y_now = rtc.getYear();
+    byte M_now = rtc.getMonth();
+    byte D_now = rtc.getDay();
+    byte h_now = rtc.getHour();
+    byte m_now = rtc.getMinute();
+    byte s_now = rtc.getSecond();
+    
+    gps.sendTimeAiding(Y_now, M_now, D_now, h_now, m_now, s_now);
+    
+    unsigned long timestampNow = getTimeStamp(Y_now, M_now, D_now, h_now, m_now, s_now);
+    
+    if(gps.firstPositionAcquired and ((timestampNow - lastFixTimestamp) < GPS_POSITION_AIDING_MAX_AGE_IN_SECONDS)) {
+      
+      gps.sendPositionAiding(gps.position.latitudeInMicroDegrees, gps.position.longitudeInMicroDegrees, gps.position.altitudeAboveMSLInCm, 
+                             Y_now, M_now, D_now, h_now, m_now, s_now);
+      
+    }
+    
+  }
+  
+  positionAcquired = gps.acquireAveragedPosition(accuracyLimit, GPS_ACQUISITION_MIN_NUM_OF_SATELLITES, GPS_AVERAGING_NUM_OF_FIXES, 
+                                                GPS_AVERAGING_WINDOW_IN_SECONDS, GPS_AVERAGING_CONVERGENCE_RADIUS_IN_CM, timeoutInS);
   
   if(positionAcquired) {
     
+    unsigned long fixTimestamp = getTimeStamp(gps.position.fix_Y_utc, gps.position.fix_M_utc, gps.position.fix_D_utc, gps.position.fix_h_utc, gps.position.fix_m_utc, gps.position.fix_s_utc);
+    
+    unsigned long rtcTimestamp = getTimeStampNow();
+    
+    if((fixTimestamp > (rtcTimestamp + SCHEDULER_RTC_ADJUSTMENT_TOLERANCE_IN_SECONDS)) or (rtcTimestamp > (fixTimestamp + SCHEDULER_RTC_ADJUSTMENT_TOLERANCE_IN_SECONDS))) rtcAdjusted = true;
+    
     rtc.setTime(gps.position.fix_h_utc, gps.position.fix_m_utc, gps.position.fix_s_utc);         // hr, min, sec
     rtc.setDate(gps.position.fix_D_utc, 0, gps.position.fix_M_utc, 0, gps.position.fix_Y_utc);   // day, weekday, month, century(1=1900, 0=2000), year(0-99)
+    
+    rtcTimeSet = true;
+    
+    lastFixTimestamp = fixTimestamp;
+    
+    gps.savePosition(INTERNAL_EEPROM_GPS_POSITION_ADDRESS);
+    
+    updateFixHistory(gps.position.latitudeInMicroDegrees, gps.position.longitudeInMicroDegrees);
 
   }
   
-  gps.powerOff();
+  // Note : gps.timeToFirstFixInMS holds the time-to-first-fix of this acquisition (0 if no fix has been obtained)
+  
+  if(GPS_BACKUP_MODE_ENABLED) gps.enterBackupMode();          // ephemeris and RTC kept alive : the next acquisition is a hot start
+  
+  else gps.powerOff();
   
   return positionAcquired;
   
@@ -474,6 +1106,47 @@ boolean acquireCurrentPosition_gpsOnOff(float accuracyLimit, int timeoutInS) {
 
 
 
+void updateFixHistory(long latitudeInMicroDegrees, long longitudeInMicroDegrees) {
+  
+  // the site is considered as stationary once GPS_STATIONARY_SITE_NUM_OF_FIXES consecutive fixes are all within GPS_STATIONARY_SITE_RADIUS_IN_CM 
+  // of each other : a fix out of this radius restarts the history (and the normal acquisition cadence) from this fix
+  
+  boolean fixWithinRadius = true;
+  
+  for(byte i = 0 ; i < fixHistoryNumOfFixes ; i++) {
+    
+    if(gps.getDistanceInCm(latitudeInMicroDegrees, longitudeInMicroDegrees, fixHistoryLatitudes[i], fixHistoryLongitudes[i]) > GPS_STATIONARY_SITE_RADIUS_IN_CM) fixWithinRadius = false;
+    
+  }
+  
+  if(!fixWithinRadius) fixHistoryNumOfFixes = 0;
+  
+  if(fixHistoryNumOfFixes == GPS_STATIONARY_SITE_NUM_OF_FIXES) {
+    
+    // the oldest fix is dropped
+    
+    for(byte i = 1 ; i < GPS_STATIONARY_SITE_NUM_OF_FIXES ; i++) {
+      
+      fixHistoryLatitudes[i - 1] = fixHistoryLatitudes[i];
+      fixHistoryLongitudes[i - 1] = fixHistoryLongitudes[i];
+      
+    }
+    
+    fixHistoryNumOfFixes--;
+    
+  }
+  
+  fixHistoryLatitudes[fixHistoryNumOfFixes] = latitudeInMicroDegrees;
+  fixHistoryLongitudes[fixHistoryNumOfFixes] = longitudeInMicroDegrees;
+  
+  fixHistoryNumOfFixes++;
+  
+  stationarySite = (fixHistoryNumOfFixes == GPS_STATIONARY_SITE_NUM_OF_FIXES);
+  
+}
+
+
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // Sensors reading and report storing functions
@@ -488,167 +1161,299 @@ boolean readSensorsAndStoreReport() {
   
   char report[REPORT_BUFFER_LENGTH];
   
-  char numToCharsBuffer[12];
-  
   unsigned long sensorDataAcquisitionTimestamp = getTimeStampNow();
   
 
-  // temperature & humidity sensor power on
+  // sensors reading : the conversions of the sensors due are run during the warm-up of the temperature & humidity sensor (powered 
+  // on and off by its driver), the MCU sleeps when no sensor is ready
+  
+  sensorPipeline.run(sensorDataAcquisitionTimestamp);
+  
+  if(batteryVoltagePipelinedSensor.resultAvailable) updatePowerTier(batteryVoltagePipelinedSensor.voltage);
+  
+  boolean urgentReport = evaluateReportTriggers();
+  
   
-  digitalWrite(SENSORS_POWER_PIN, LOW);          
+  // report construction (without the statistics fields if they do not fit in the buffer)
+  
+  boolean reportComplete = buildReport(report, sizeof(report), sensorDataAcquisitionTimestamp, REPORT_STATISTICS_FIELDS_ENABLED);
+  
+  if(!reportComplete and REPORT_STATISTICS_FIELDS_ENABLED) reportComplete = buildReport(report, sizeof(report), sensorDataAcquisitionTimestamp, false);
+  
+  sensorPipeline.resetStatistics();
+  
+  if(!reportComplete) return false;            // truncated report : not stored
+  
+ 
+  // report storing
+       
+  success = mStore.storeMessage(report, urgentReport);
+  
+  if(success and urgentReport) urgentReportStored = true;
+  
+  return success;
 
+ }
 
-  // temperature and humidity reading
 
-  float temperature = TEMPERATURE_UNDEFINED_VALUE;
-  float humidity = HUMIDITY_UNDEFINED_VALUE;          
- 
-  delay(2000);                                          
+
+boolean evaluateReportTriggers() {
   
-  for(byte i=0 ; i < 3 ; i++) {              
-    
-    int chk = temperatureHumiditySensor.read22(TEMPERATURE_HUMIDITY_SENSOR_DATA_PIN);
+  // returns true if at least one of the triggers fires (to be called before the statistics are reset)
+  
+  boolean triggerFired = false;
+  
+  byte sensorIndex;
+  byte fieldIndex;
   
-    if(chk == DHTLIB_OK) {
+  for(byte triggerIndex = 0 ; triggerIndex < NUM_OF_REPORT_TRIGGERS ; triggerIndex++) {
     
-      temperature = temperatureHumiditySensor.temperature;
-      humidity = temperatureHumiditySensor.humidity;
+    const FieldTrigger *trigger = &REPORT_TRIGGERS[triggerIndex];
+    
+    if(!sensorPipeline.findField(trigger->fieldName, &sensorIndex, &fieldIndex)) continue;
+    
+    PipelinedSensor *sensor = sensorPipeline.getSensor(sensorIndex);
+    
+    FieldStatistics *statistics = sensorPipeline.getFieldStatistics(sensorIndex, fieldIndex);
+    
+    long value, minValue, maxValue;
+    
+    if((statistics != NULL) and (statistics->numOfValues > 0)) {
       
-      break;
+      value = statistics->getMean();
+      minValue = statistics->minValue;
+      maxValue = statistics->maxValue;
+      
+    }
     
-    } 
+    else if((statistics == NULL) and sensor->resultAvailable) {
+      
+      value = sensor->getFieldValue(fieldIndex);
+      minValue = value;
+      maxValue = value;
+      
+    }
+    
+    else continue;                // no value for this report : the state of the trigger is kept
+    
+    boolean outOfRange = (minValue < trigger->lowLimit) or (maxValue > trigger->highLimit);
     
-    delay(1000);
+    if(outOfRange and !triggersOutOfRange[triggerIndex]) triggerFired = true;
+    
+    if(triggersLastValuesAvailable[triggerIndex] and (trigger->maxChange != FIELD_TRIGGER_NO_LIMIT) and (labs(value - triggersLastValues[triggerIndex]) > trigger->maxChange)) triggerFired = true;
+    
+    triggersOutOfRange[triggerIndex] = outOfRange;
+    
+    triggersLastValues[triggerIndex] = value;
+    triggersLastValuesAvailable[triggerIndex] = true;
     
   }
   
-  // temperature & humidity sensor power off
+  return triggerFired;
+  
+}
+
+
+
+boolean buildReport(char *report, byte reportBufferLength, unsigned long timestamp, boolean statisticsFieldsIncluded) {
   
-  digitalWrite(SENSORS_POWER_PIN, HIGH);                    
+  // the schema is given by the sensors registry : "id", "ts", the fields of the sensors (means of the oversampled sensors), then 
+  // the optional statistics fields. Returns false if the report has been truncated
   
+  ReportWriter<REPORT_FORMAT> reportWriter(report, reportBufferLength);
   
-  // pressure reading
+  reportWriter.addString("id", STATION_ID);
   
-  float pressure = PRESSURE_UNDEFINED_VALUE;
+  if(timestamp != 0) reportWriter.addUnsigned("ts", timestamp);
+  else reportWriter.addEmpty("ts");
   
-  float measuredPressure = pressureSensor.readPressure() / 100.0;
-   
-  if((measuredPressure > 900.0) and (measuredPressure < 1100.0)) {
-     
-   pressure = measuredPressure;
-     
+  for(byte sensorIndex = 0 ; sensorIndex < sensorPipeline.getNumOfSensors() ; sensorIndex++) {
+    
+    PipelinedSensor *sensor = sensorPipeline.getSensor(sensorIndex);
+    
+    for(byte fieldIndex = 0 ; fieldIndex < sensor->getNumOfFields() ; fieldIndex++) {
+      
+      const SensorField *field = sensor->getField(fieldIndex);
+      
+      FieldStatistics *statistics = sensorPipeline.getFieldStatistics(sensorIndex, fieldIndex);
+      
+      if(statistics != NULL) {
+        
+        if(statistics->numOfValues > 0) reportWriter.addFixedPoint(field->name, statistics->getMean(), field->valueNumOfDecimals, field->reportNumOfDecimals);
+        else reportWriter.addEmpty(field->name);
+        
+      }
+      
+      else if(sensor->resultAvailable) reportWriter.addFixedPoint(field->name, sensor->getFieldValue(fieldIndex), field->valueNumOfDecimals, field->reportNumOfDecimals);
+      
+      else reportWriter.addEmpty(field->name);
+      
+    }
+    
+  }
+  
+  if(statisticsFieldsIncluded) {
+    
+    char fieldName[16];                 // sensors fields names : 11 chars max
+    
+    for(byte sensorIndex = 0 ; sensorIndex < sensorPipeline.getNumOfSensors() ; sensorIndex++) {
+      
+      PipelinedSensor *sensor = sensorPipeline.getSensor(sensorIndex);
+      
+      if(sensorPipeline.getFieldStatistics(sensorIndex, 0) == NULL) continue;
+      
+      for(byte fieldIndex = 0 ; fieldIndex < sensor->getNumOfFields() ; fieldIndex++) {
+        
+        const SensorField *field = sensor->getField(fieldIndex);
+        
+        FieldStatistics *statistics = sensorPipeline.getFieldStatistics(sensorIndex, fieldIndex);
+        
+        strcpy(fieldName, field->name);
+        strcat(fieldName, "_min");
+        
+        if(statistics->numOfValues > 0) reportWriter.addFixedPoint(fieldName, statistics->minValue, field->valueNumOfDecimals, field->reportNumOfDecimals);
+        else reportWriter.addEmpty(fieldName);
+        
+        strcpy(fieldName, field->name);
+        strcat(fieldName, "_max");
+        
+        if(statistics->numOfValues > 0) reportWriter.addFixedPoint(fieldName, statistics->maxValue, field->valueNumOfDecimals, field->reportNumOfDecimals);
+        else reportWriter.addEmpty(fieldName);
+        
+      }
+      
+      strcpy(fieldName, sensor->getField(0)->name);            // samples count of the sensor
+      strcat(fieldName, "_n");
+      
+      reportWriter.addUnsigned(fieldName, sensorPipeline.getFieldStatistics(sensorIndex, 0)->numOfValues);
+      
+    }
+    
   }
+  
+  return reportWriter.end();
+  
+}
 
 
-  // device temperature reading
+
+boolean storeHealthReport() {
+  
+  // "health" record ("@health|id|ts|..." or {"rec":"health",...}, see ReportWriter::addRecordType()), "tier" : the current power 
+  // tier, then the optional energy fields : on times (s) of the subsystems since the counters have been reset, and estimated charge (mAh)
+  
+  boolean success = false;
   
-  float deviceTemperature = DEVICE_TEMPERATURE_UNDEFINED_VALUE;
+  char report[REPORT_BUFFER_LENGTH];
+  
+  unsigned long timestamp = getTimeStampNow();
   
-  float measuredDeviceTemperature = pressureSensor.readTemperature();
+  updateEnergyCounters();
   
-  deviceTemperature = measuredDeviceTemperature;
+  ReportWriter<REPORT_FORMAT> reportWriter(report, sizeof(report));
   
+  reportWriter.addRecordType("health");
   
-  // device battery voltage reading
+  reportWriter.addString("id", STATION_ID);
   
-  float deviceBatteryVoltage = BATTERY_VOLTAGE_UNDEFINED_VALUE;
+  if(timestamp != 0) reportWriter.addUnsigned("ts", timestamp);
+  else reportWriter.addEmpty("ts");
   
-  unsigned long accuAdcReadings = 0;
+  reportWriter.addUnsigned("tier", powerTier);
+  
+  if(HEALTH_REPORT_ENERGY_FIELDS_ENABLED) {
+    
+    unsigned long chargeInTenthsOfMAh = 0;
+    
+    for(byte counterIndex = 0 ; counterIndex < NUM_OF_ENERGY_COUNTERS ; counterIndex++) {
+      
+      reportWriter.addUnsigned(ENERGY_COUNTERS_FIELDS_NAMES[counterIndex], energyCounters.getOnTimeInS(counterIndex));
+      
+      chargeInTenthsOfMAh += energyCounters.getChargeInTenthsOfMAh(counterIndex, ENERGY_COUNTERS_CURRENTS_IN_MA[counterIndex]);
+      
+    }
+    
+    reportWriter.addFixedPoint("q_mah", chargeInTenthsOfMAh, 1, 1);
     
-  for(byte i=0 ; i < 10; i++) {
-    accuAdcReadings += analogRead(DEVICE_BATTERY_VOLTAGE_PIN);
   }
   
-  if(accuAdcReadings > 0) deviceBatteryVoltage = accuAdcReadings * ADC_REF_VOLTAGE * 156.0 / (10 * 1024 * 56.0);
+  if(!reportWriter.end()) return false;
   
+  success = mStore.storeMessage(report);
   
-  // report construction
+  return success;
   
-  char sep[2] = {'|', '\0'};
+}
+
+
+
+void updateEnergyCounters() {
   
-  strcpy(report, STATION_ID);
+  // the references are cumulative times (ms) : millis() does not run while the MCU is in power down mode
   
-  strcat(report, sep);
+  energyCounters.update(ENERGY_COUNTER_MCU_AWAKE, millis());
+  energyCounters.update(ENERGY_COUNTER_MODEM_ON, modem.powerOnTimeInMS);
+  energyCounters.update(ENERGY_COUNTER_GPS_ON, gps.powerOnTimeInMS);
+  energyCounters.update(ENERGY_COUNTER_SENSORS_ON, sensorPipeline.runTimeInMS);
+  energyCounters.update(ENERGY_COUNTER_I2C_BUSY, mStore.busyTimeInMS);
   
-  if(sensorDataAcquisitionTimestamp != 0) strcat(report, ultoa(sensorDataAcquisitionTimestamp, numToCharsBuffer, 10));
-           
-  strcat(report, sep);
+}
+
 
-  if(temperature != TEMPERATURE_UNDEFINED_VALUE) {
-   
-    strcat(report, dtostrf(temperature, 1, 1, numToCharsBuffer));
-    
-  }
 
-  strcat(report, sep);
+#if SPAN_TRACE_ENABLED
+
+void exportSpanTrace() {
   
-  if(humidity != HUMIDITY_UNDEFINED_VALUE) {
-    
-    strcat(report, dtostrf(humidity, 1, 1, numToCharsBuffer));
-    
-  }
+  // the records are dumped and / or stored as "trace" reports (as many reports as needed), then the ring is cleared
+  
+  spanTrace.pause();
   
-  strcat(report, sep);
+  if(SPAN_TRACE_DUMP_ENABLED) spanTrace.dump(&softSerialDebug);
   
-  if(pressure != PRESSURE_UNDEFINED_VALUE) {
+  byte recordIndex = 0;
+  
+  while(SPAN_TRACE_UPLOAD_ENABLED and (recordIndex < spanTrace.getNumOfRecords())) {
     
-    strcat(report, dtostrf(pressure, 1, 1, numToCharsBuffer));
+    char report[REPORT_BUFFER_LENGTH];
     
-  }
-  
-  if(gps.firstPositionAcquired) {
-
-    strcat(report, sep);
+    unsigned long timestamp = getTimeStampNow();
     
-    unsigned long fixPositionTimestamp = getTimeStamp(gps.position.fix_Y_utc, gps.position.fix_M_utc, gps.position.fix_D_utc, gps.position.fix_h_utc, gps.position.fix_m_utc, gps.position.fix_s_utc);
-
-    strcat(report, ultoa(fixPositionTimestamp, numToCharsBuffer, 10));
-      
-    strcat(report, sep);
-
-    strcat(report, dtostrf(gps.position.latitude, 1, 4, numToCharsBuffer));
+    ReportWriter<REPORT_FORMAT> reportWriter(report, sizeof(report));
+    
+    reportWriter.addRecordType("trace");
+    
+    reportWriter.addString("id", STATION_ID);
+    
+    if(timestamp != 0) reportWriter.addUnsigned("ts", timestamp);
+    else reportWriter.addEmpty("ts");
+    
+    byte numOfRecordsInReport = 0;
+    
+    while((recordIndex < spanTrace.getNumOfRecords()) and (reportWriter.getLength() < (sizeof(report) - 40))) {      // a triplet : 36 chars max (JSON)
       
-    strcat(report, sep);
+      SpanTraceRecord *spanRecord = spanTrace.getRecord(recordIndex);
       
-    strcat(report, dtostrf(gps.position.longitude, 1, 4, numToCharsBuffer));
+      reportWriter.addUnsigned("e", spanRecord->eventID);
+      reportWriter.addUnsigned("t", spanRecord->startMS);
+      reportWriter.addUnsigned("d", spanRecord->durationInMS);
       
-    strcat(report, sep);
+      recordIndex++;
+      numOfRecordsInReport++;
       
-    strcat(report, itoa(gps.position.altitudeAboveMSL, numToCharsBuffer, 10)); 
-    
-  }
-  
-  else {
-   
-   for(byte i = 0 ; i < 4 ; i++) strcat(report, sep);
-    
-  }
-
-  
-  strcat(report, sep);
-  
-  if(deviceTemperature != DEVICE_TEMPERATURE_UNDEFINED_VALUE) {
+    }
     
-    strcat(report, dtostrf(deviceTemperature, 1, 1, numToCharsBuffer));
+    if(reportWriter.end() and (numOfRecordsInReport > 0)) mStore.storeMessage(report);
     
   }
   
-  strcat(report, sep);
-  
-  if(deviceBatteryVoltage != BATTERY_VOLTAGE_UNDEFINED_VALUE) {
-    
-    strcat(report, dtostrf(deviceBatteryVoltage, 1, 2, numToCharsBuffer));
-    
-  }
+  spanTrace.clear();
   
- 
-  // report storing
-       
-  success = mStore.storeMessage(report);
+  spanTrace.resume();
   
-  return success;
+}
 
- }
+#endif
 
 
 
@@ -660,19 +1465,19 @@ boolean readSensorsAndStoreReport() {
 
 
     
-boolean modemPowerOn_httpPostStoredReports_modemPowerOff(int maxNumOfReportsToBeSent) {
+boolean modemPowerOn_httpPostStoredReports_modemPowerOff(int maxNumOfReportsToBeSent, boolean urgentReportsOnly) {
   
   boolean success = false;
   
   // are there any stored reports to be sent ?
   
-  int numOfReportsStored = mStore.getMessagesCount();
+  int numOfReportsStored = mStore.getMessagesCount(urgentReportsOnly);
   
   if(numOfReportsStored > 0) {
      
     boolean connectedToNet = modemPowerOn_ConnectToNet();
   
-    if(connectedToNet) success = httpPostStoredReports(maxNumOfReportsToBeSent);
+    if(connectedToNet) success = httpPostStoredReports(maxNumOfReportsToBeSent, urgentReportsOnly);
 
     modem.powerOff();
   
@@ -699,6 +1504,8 @@ boolean modemPowerOn_ConnectToNet() {
     
   modem.activateCommunication();
   
+  modem.negotiateBaudRate();                      // the rate negotiated during a previous session is normally reused as is
+  
 
   // is the modem registered ?
   
@@ -706,6 +1513,8 @@ boolean modemPowerOn_ConnectToNet() {
     
     modem.configure();
     
+    if((UPLOAD_TRANSPORT == UPLOAD_TRANSPORT_TCP) && BACKUP_SERVER_ENABLED) modem.enableMultiConnectionMode();
+    
     for(byte attempt=0 ; attempt < 60 ; attempt++) {
       
       registered = modem.isRegistered();
@@ -751,7 +1560,8 @@ boolean modemPowerOn_ConnectToNet() {
  
     for(byte attempt=0 ; attempt < 30 ; attempt++) {
       
-      connectedToNet = modem.isConnectedToNet();
+      if(UPLOAD_TRANSPORT == UPLOAD_TRANSPORT_HTTP_STACK) connectedToNet = modem.isBearerConnected();
+      else connectedToNet = modem.isConnectedToNet();
       
       if(connectedToNet) break;
       
@@ -759,7 +1569,8 @@ boolean modemPowerOn_ConnectToNet() {
         
         delay(1000);
         
-        modem.connectToNet(GPRS_NETWORK_APN, GPRS_USERNAME, GPRS_PASSWORD);
+        if(UPLOAD_TRANSPORT == UPLOAD_TRANSPORT_HTTP_STACK) modem.connectBearer(GPRS_NETWORK_APN, GPRS_USERNAME, GPRS_PASSWORD);
+        else modem.connectToNet(GPRS_NETWORK_APN, GPRS_USERNAME, GPRS_PASSWORD);
         
       }
       
@@ -774,21 +1585,25 @@ boolean modemPowerOn_ConnectToNet() {
 
 
 
-boolean httpPostStoredReports(int maxNumOfReportsToBeSent) {
+boolean httpPostStoredReports(int maxNumOfReportsToBeSent, boolean urgentReportsOnly) {
   
   // returns true if the first header of the response contains the http code : 200 
+  // urgentReportsOnly : only the reports stored with the priority flag are sent (and deleted)
   
   boolean success = false;
   
   // are there any stored reports to be sent ?
   
-  int numOfReportsStored = mStore.getMessagesCount();
+  int numOfReportsStored = mStore.getMessagesCount(urgentReportsOnly);
     
   if(numOfReportsStored == 0) success = true;
   
   else {
     
-    boolean connectedToNet = modem.isConnectedToNet();
+    boolean connectedToNet;
+    
+    if(UPLOAD_TRANSPORT == UPLOAD_TRANSPORT_HTTP_STACK) connectedToNet = modem.isBearerConnected();
+    else connectedToNet = modem.isConnectedToNet();
   
     
     if(connectedToNet) {
@@ -808,7 +1623,7 @@ boolean httpPostStoredReports(int maxNumOfReportsToBeSent) {
 
       for(int pageIndex = 0 ; (pageIndex < 1024) && (reportsCounter < numOfReportsToBeSent) ; pageIndex++) {
         
-        reportLength = mStore.getMessageLength(pageIndex);
+        reportLength = mStore.getMessageLength(pageIndex, urgentReportsOnly);
         
         if(reportLength > 0) {
           
@@ -820,172 +1635,408 @@ boolean httpPostStoredReports(int maxNumOfReportsToBeSent) {
       }
       
 
-      byte maxNumOfReportsForOneBlockTransmission = 6;          
-      byte maxNumOfReportsPerTransmissionBlock = 10;
-
-      char report[124];
-
-      char incomingCharsBuffer[80];
+      char formFieldName[] = "uploadedfile";                     // this value must march the corresponding form field name on the server side 
       
       
-      // TCP connection and request transmission
+      // TCP connection(s) and request transmission (or request transmission with the modem's built-in HTTP stack)
       
-      boolean tcpConnectSuccess = modem.tcpConnect(SERVER_NAME, SERVER_PORT, 10);
+      if(UPLOAD_TRANSPORT == UPLOAD_TRANSPORT_HTTP_STACK) success = httpStackPostStoredReports(numOfReportsToBeSent, formFieldName, urgentReportsOnly);     // the sent reports are deleted by each request
       
-      if(tcpConnectSuccess) {
-        
-        
-        char formFieldName[] = "uploadedfile";                     // this value must march the corresponding form field name on the server side 
-        
+      else if(BACKUP_SERVER_ENABLED) success = multiServerPostStoredReports(numOfReportsToBeSent, totalContentLength, formFieldName, urgentReportsOnly);
+      
+      else {
+      
+        boolean tcpConnectSuccess = modem.tcpConnect(SERVER_NAME, SERVER_PORT, 10, getTimeStampNow());
         
-        if(numOfReportsToBeSent <= maxNumOfReportsForOneBlockTransmission) {                            
+        if(tcpConnectSuccess) {
+          
+          char incomingCharsBuffer[80];
+          
+          tcpSendStoredReports(SERVER_NAME, numOfReportsToBeSent, totalContentLength, formFieldName, urgentReportsOnly);
+          
           
-          modem.requestAT(F("AT+CIPSPRT=2"), 2, 2000);             // we don't want the "SEND OK" message to be returned after each transmission
+          // server's response interpretation        
           
-          modem.requestAT(F("AT+CIPSEND"), 2, 15000);
+          modem.retrieveHttpResponseStatusLine(incomingCharsBuffer, sizeof(incomingCharsBuffer), 90000);    // the timeout must be long enough for the server to respond after the "ingestion" of tens of reports
           
-          modem.echoHttpRequestInitHeaders(SERVER_NAME, SERVER_POST_URL, "POST");
-          modem.echoHttpPostFileRequestAdditionalHeadersPart1(totalContentLength, formFieldName);
+          if(strstr(incomingCharsBuffer, "200") != NULL) success = true;
+                  
+          modem.tcpClose();
+          
+        }
+        
+      }
+      
+      
+      // if success, we delete the corresponding reports in the store
+       
+      if(success && (UPLOAD_TRANSPORT != UPLOAD_TRANSPORT_HTTP_STACK)) {
+        
+        reportsCounter = 0;
+       
+        for(int pageIndex = 0 ; (pageIndex < 1024) && (reportsCounter < numOfReportsToBeSent) ; pageIndex++) {
           
-          reportsCounter = 0;
+          reportLength = mStore.getMessageLength(pageIndex, urgentReportsOnly);
           
-          for(int pageIndex = 0 ; (pageIndex < 1024) && (reportsCounter < numOfReportsToBeSent); pageIndex++) {
+          if(reportLength > 0) {
             
-            reportLength = mStore.getMessageLength(pageIndex);
+            mStore.clearPage(pageIndex);
             
-            if(reportLength > 0) {
-              
-              mStore.retrieveMessage(pageIndex, report);
-              
-              modem.serialConnection.print(report);
-              modem.serialConnection.print("\r\n");
-              
-              reportsCounter++;
-              
-            }
+            reportsCounter++;
             
           }
           
-          modem.echoHttpPostFileRequestAdditionalHeadersPart2();
-          
-          modem.serialConnection.print((char) 26);
-          
         }
         
+      }  
+    
+    }
+    
+  }
+
+  return success;
+
+}
+
+
+
+boolean tcpSendStoredReports(char *serverName, int numOfReportsToBeSent, long totalContentLength, char *formFieldName, boolean urgentReportsOnly) {
+  
+  // the stored reports are sent (as a file) over the current TCP connection : returns false if a transmission error has been detected
+  
+  boolean sendError = false;
+  
+  byte maxNumOfReportsForOneBlockTransmission = 6;          
+  byte maxNumOfReportsPerTransmissionBlock = 10;
+  
+  char report[124];
+  
+  char incomingCharsBuffer[80];
+  
+  byte reportLength;
+  
+  int reportsCounter;
+  
+  TRACE_SPAN_VARIABLE(tcpSendBlockStartMS);
+  
+  
+  if(numOfReportsToBeSent <= maxNumOfReportsForOneBlockTransmission) {                            
+    
+    modem.requestAT(F("AT+CIPSPRT=2"), 2, 2000);             // we don't want the "SEND OK" message to be returned after each transmission
+    
+    TRACE_SPAN_BEGIN(tcpSendBlockStartMS);
+    
+    modem.tcpSendBegin();
+    
+    modem.echoHttpRequestInitHeaders(serverName, SERVER_POST_URL, "POST");
+    modem.echoHttpPostFileRequestAdditionalHeadersPart1(totalContentLength, formFieldName);
+    
+    reportsCounter = 0;
+    
+    for(int pageIndex = 0 ; (pageIndex < 1024) && (reportsCounter < numOfReportsToBeSent); pageIndex++) {
+      
+      reportLength = mStore.getMessageLength(pageIndex, urgentReportsOnly);
+      
+      if(reportLength > 0) {
+        
+        mStore.retrieveMessage(pageIndex, report);
+        
+        modem.serialConnection.print(report);
+        modem.serialConnection.print("\r\n");
+        
+        reportsCounter++;
+        
+      }
+      
+    }
+    
+    modem.echoHttpPostFileRequestAdditionalHeadersPart2();
+    
+    modem.serialConnection.print((char) 26);
+    
+    TRACE_SPAN_END(TRACE_EVENT_TCP_SEND_BLOCK, tcpSendBlockStartMS);
+    
+  }
+  
+    
+  else {      
+    
+    modem.requestAT(F("AT+CIPSPRT=1"), 2, 2000);             // we want the "SEND OK" message to be returned after each transmission, in order to check that everything was OK 
+
+    TRACE_SPAN_BEGIN(tcpSendBlockStartMS);
+    
+    modem.tcpSendBegin();
+    
+    modem.echoHttpRequestInitHeaders(serverName, SERVER_POST_URL, "POST");
+    modem.echoHttpPostFileRequestAdditionalHeadersPart1(totalContentLength, formFieldName);
+    
+    modem.serialConnection.print((char) 26);
+    
+    modem.retrieveIncomingCharsFromLineToLine(incomingCharsBuffer, sizeof(incomingCharsBuffer), 0, 1, 30000);
+    if(strstr(incomingCharsBuffer, "OK") == NULL) sendError = true;
+    
+    TRACE_SPAN_END(TRACE_EVENT_TCP_SEND_BLOCK, tcpSendBlockStartMS);
+             
+
+    delay(300);
+    
+    
+    reportsCounter = 0;
+
+    for(int pageIndex = 0 ; (pageIndex < 1024) && (reportsCounter < numOfReportsToBeSent) && !sendError; pageIndex++) {
+      
+      reportLength = mStore.getMessageLength(pageIndex, urgentReportsOnly);
+      
+      if(reportLength > 0) {
+        
+        if((reportsCounter % maxNumOfReportsPerTransmissionBlock) == 0) {
           
-        else {      
-            
-          boolean sendError = false;
+          delay(300);
           
-          modem.requestAT(F("AT+CIPSPRT=1"), 2, 2000);             // we want the "SEND OK" message to be returned after each transmission, in order to check that everything was OK 
-  
-          modem.requestAT(F("AT+CIPSEND"), 2, 15000);
+          TRACE_SPAN_BEGIN(tcpSendBlockStartMS);
+          
+          modem.tcpSendBegin();
+          
+        }
           
-          modem.echoHttpRequestInitHeaders(SERVER_NAME, SERVER_POST_URL, "POST");
-          modem.echoHttpPostFileRequestAdditionalHeadersPart1(totalContentLength, formFieldName);
+        mStore.retrieveMessage(pageIndex, report);
+        
+        modem.serialConnection.print(report);
+        modem.serialConnection.print("\r\n");
+        
+        
+        if(((reportsCounter % maxNumOfReportsPerTransmissionBlock) == (maxNumOfReportsPerTransmissionBlock - 1)) || (reportsCounter == (numOfReportsToBeSent - 1))) {
           
           modem.serialConnection.print((char) 26);
           
-          modem.retrieveIncomingCharsFromLineToLine(incomingCharsBuffer, sizeof(incomingCharsBuffer), 0, 1, 30000);
+          modem.retrieveIncomingCharsFromLineToLine(incomingCharsBuffer, sizeof(incomingCharsBuffer), 0, 1, 30000);                 
           if(strstr(incomingCharsBuffer, "OK") == NULL) sendError = true;
-                   
-      
-          delay(300);
           
+          TRACE_SPAN_END(TRACE_EVENT_TCP_SEND_BLOCK, tcpSendBlockStartMS);
           
-          reportsCounter = 0;
+        }
+        
+        reportsCounter++;
+        
+      }
+      
+    }
+    
+    
+    if(!sendError) {
   
-          for(int pageIndex = 0 ; (pageIndex < 1024) && (reportsCounter < numOfReportsToBeSent) && !sendError; pageIndex++) {
-            
-            reportLength = mStore.getMessageLength(pageIndex);
-            
-            if(reportLength > 0) {
-              
-              if((reportsCounter % maxNumOfReportsPerTransmissionBlock) == 0) {
-                
-                delay(300);
-                
-                modem.requestAT(F("AT+CIPSEND"), 2, 15000);
-                
-              }
-                
-              mStore.retrieveMessage(pageIndex, report);
-              
-              modem.serialConnection.print(report);
-              modem.serialConnection.print("\r\n");
-              
-              
-              if(((reportsCounter % maxNumOfReportsPerTransmissionBlock) == (maxNumOfReportsPerTransmissionBlock - 1)) || (reportsCounter == (numOfReportsToBeSent - 1))) {
-                
-                modem.serialConnection.print((char) 26);
-                
-                modem.retrieveIncomingCharsFromLineToLine(incomingCharsBuffer, sizeof(incomingCharsBuffer), 0, 1, 30000);                 
-                if(strstr(incomingCharsBuffer, "OK") == NULL) sendError = true;
-                
-              }
-              
-              reportsCounter++;
-              
-            }
-            
-          }
+      delay(300);
+    
+      modem.requestAT(F("AT+CIPSPRT=2"), 2, 2000);             // we don't want anymore the "SEND OK" message to be returned after each transmission, in order to get only the server's response after the last one
+      
+      TRACE_SPAN_BEGIN(tcpSendBlockStartMS);
+      
+      modem.tcpSendBegin();
+      modem.echoHttpPostFileRequestAdditionalHeadersPart2();
+      modem.serialConnection.print((char) 26);
+      
+      TRACE_SPAN_END(TRACE_EVENT_TCP_SEND_BLOCK, tcpSendBlockStartMS);
+      
+    }
+       
+  }
+
+  
+  return !sendError;
+  
+}
+
+
+
+boolean multiServerPostStoredReports(int numOfReportsToBeSent, long totalContentLength, char *formFieldName, boolean urgentReportsOnly) {
+  
+  // multi-connection mode : the connections to the primary and backup servers are opened at the same time, the request is sent to 
+  // the first connected server (or to all connected servers) and the first "200" response is considered as a success, so that a slow
+  // server can't burn more than MULTI_SERVER_RESPONSE_TIMEOUT_IN_MS with the modem at full power
+  
+  boolean success = false;
+  
+  char *serverNames[2];
+  
+  serverNames[PRIMARY_SERVER_LINK] = SERVER_NAME;
+  serverNames[BACKUP_SERVER_LINK] = BACKUP_SERVER_NAME;
+  
+  
+  // connections
+  
+  modem.tcpConnectStart(PRIMARY_SERVER_LINK, SERVER_NAME, SERVER_PORT);
+  modem.tcpConnectStart(BACKUP_SERVER_LINK, BACKUP_SERVER_NAME, BACKUP_SERVER_PORT);
+  
+  byte linkMask = (1 << PRIMARY_SERVER_LINK) | (1 << BACKUP_SERVER_LINK);
+  
+  byte connectedLinkMask = modem.waitForTcpConnect(linkMask, (BACKUP_SERVER_POLICY == BACKUP_SERVER_POLICY_ALL_CONNECTED), MULTI_SERVER_CONNECT_TIMEOUT_IN_MS);
+  
+  if((BACKUP_SERVER_POLICY == BACKUP_SERVER_POLICY_FIRST_CONNECTED) && (connectedLinkMask == linkMask)) connectedLinkMask = (1 << PRIMARY_SERVER_LINK);
+  
+  
+  // request transmission
+  
+  byte pendingLinkMask = 0;
+  
+  for(byte linkNum = 0 ; linkNum < 2 ; linkNum++) {
+    
+    if(connectedLinkMask & (1 << linkNum)) {
+      
+      modem.selectTcpLink(linkNum);
+      
+      if(tcpSendStoredReports(serverNames[linkNum], numOfReportsToBeSent, totalContentLength, formFieldName, urgentReportsOnly)) pendingLinkMask |= (1 << linkNum);
+      
+    }
+    
+  }
+  
+  
+  // servers' responses interpretation (a response received while the request was being sent to the other server has already been 
+  // recorded by the modem library)
+  
+  unsigned long responseWaitStartMS = millis();
+  
+  while((pendingLinkMask != 0) && !success && ((millis() - responseWaitStartMS) < MULTI_SERVER_RESPONSE_TIMEOUT_IN_MS)) {
+    
+    char responseLinkNum = modem.waitForHttpResponse(pendingLinkMask, MULTI_SERVER_RESPONSE_TIMEOUT_IN_MS - (millis() - responseWaitStartMS));
+    
+    if(responseLinkNum < 0) break;
+    
+    if(modem.getHttpResponseStatusCode(responseLinkNum) == 200) success = true;
+    
+    else pendingLinkMask &= ~(1 << responseLinkNum);
+    
+  }
+  
+  
+  // all the links are closed (a late connection may have been established on the link which was not selected)
+  
+  for(byte linkNum = 0 ; linkNum < 2 ; linkNum++) {
+    
+    modem.selectTcpLink(linkNum);
+    
+    modem.tcpClose();
+    
+  }
+  
+  modem.selectTcpLink(PRIMARY_SERVER_LINK);
+  
+  return success;
+  
+}
+
+
+
+boolean httpStackPostStoredReports(int numOfReportsToBeSent, char *formFieldName, boolean urgentReportsOnly) {
+  
+  // the stored reports are posted (as a file) with the modem's built-in HTTP stack, and only the status code of the responses is read back
+  // each body is loaded in one AT+HTTPDATA block, which must be input within the HTTPDATA window : the reports are posted with as many
+  // requests as needed (at most the num of reports whose body fits in getHttpStackMaxDataLength() per request), and the reports of a 
+  // request are deleted from the store as soon as it has been answered with the status code 200
+  // returns true if all the requests have been answered with the status code 200
+  
+  boolean success = true;
+  
+  char contentType[] = "multipart/form-data; boundary=" HTTP_POST_FILE_BOUNDARY;
+  
+  char report[REPORT_BUFFER_LENGTH];
+  
+  byte reportLength;
+  
+  int maxNumOfReportsPerRequest = (modem.getHttpStackMaxDataLength() - modem.getHttpPostFileBodyLength(0, formFieldName)) / (REPORT_BUFFER_LENGTH + 2);
+  
+  int numOfReportsSent = 0;
+  
+  if(!modem.httpStackBegin(SERVER_NAME, SERVER_PORT, SERVER_POST_URL, contentType)) success = false;
+  
+  while(success && (numOfReportsSent < numOfReportsToBeSent)) {
+    
+    // the reports of the previous requests have been deleted : the request holds the first stored reports
+    
+    int numOfReportsInRequest = min(numOfReportsToBeSent - numOfReportsSent, maxNumOfReportsPerRequest);
+    
+    int reportsCounter = 0;
+    
+    long contentLength = 0;
+    
+    for(int pageIndex = 0 ; (pageIndex < 1024) && (reportsCounter < numOfReportsInRequest) ; pageIndex++) {
+      
+      reportLength = mStore.getMessageLength(pageIndex, urgentReportsOnly);
+      
+      if(reportLength > 0) {
+        
+        contentLength += (reportLength + 2);     // "\r\n" will be sent after each report 
+        reportsCounter++;
+        
+      }
+      
+    }
+    
+    numOfReportsInRequest = reportsCounter;
+    
+    success = false;
+    
+    if((numOfReportsInRequest > 0) && modem.httpStackLoadDataBegin(modem.getHttpPostFileBodyLength(contentLength, formFieldName))) {
+      
+      modem.echoHttpPostFileBodyPart1(formFieldName);
+      
+      reportsCounter = 0;
+      
+      for(int pageIndex = 0 ; (pageIndex < 1024) && (reportsCounter < numOfReportsInRequest); pageIndex++) {
+        
+        reportLength = mStore.getMessageLength(pageIndex, urgentReportsOnly);
+        
+        if(reportLength > 0) {
           
+          mStore.retrieveMessage(pageIndex, report);
           
-          if(!sendError) {
-        
-            delay(300);
+          modem.serialConnection.print(report);
+          modem.serialConnection.print("\r\n");
           
-            modem.requestAT(F("AT+CIPSPRT=2"), 2, 2000);             // we don't want anymore the "SEND OK" message to be returned after each transmission, in order to get only the server's response after the last one
-            
-            modem.requestAT(F("AT+CIPSEND"), 2, 15000);
-            modem.echoHttpPostFileRequestAdditionalHeadersPart2();
-            modem.serialConnection.print((char) 26);
-            
-          }
-             
-        }
+          reportsCounter++;
           
+        }
         
-       // server's response interpretation        
+      }
+      
+      modem.echoHttpPostFileRequestAdditionalHeadersPart2();
+      
+      if(modem.httpStackLoadDataEnd()) {
         
-        modem.retrieveHttpResponseStatusLine(incomingCharsBuffer, sizeof(incomingCharsBuffer), 90000);    // the timeout must be long enough for the server to respond after the "ingestion" of tens of reports
+        if(modem.httpStackAction(HTTP_STACK_ACTION_POST, 90000) == 200) success = true;     // the timeout must be long enough for the server to respond after the "ingestion" of tens of reports
         
-        if(strstr(incomingCharsBuffer, "200") != NULL) success = true;
-                
-        modem.tcpClose();
+      }
+      
+    }
+    
+    if(success) {
+      
+      reportsCounter = 0;
+      
+      for(int pageIndex = 0 ; (pageIndex < 1024) && (reportsCounter < numOfReportsInRequest) ; pageIndex++) {
         
+        reportLength = mStore.getMessageLength(pageIndex, urgentReportsOnly);
         
-        // if success, we delete the corresponding reports in the store
-         
-        if(success) {
+        if(reportLength > 0) {
           
-          reportsCounter = 0;
-         
-          for(int pageIndex = 0 ; (pageIndex < 1024) && (reportsCounter < numOfReportsToBeSent) ; pageIndex++) {
-            
-            reportLength = mStore.getMessageLength(pageIndex);
-            
-            if(reportLength > 0) {
-              
-              mStore.clearPage(pageIndex);
-              
-              reportsCounter++;
-              
-            }
-            
-          }
+          mStore.clearPage(pageIndex);
           
-        }  
-        
+          reportsCounter++;
+          
+        }
         
       }
-    
+      
+      numOfReportsSent += numOfReportsInRequest;
+      
     }
     
   }
-
+  
+  modem.httpStackEnd();
+  
   return success;
-
+  
 }  
     
 
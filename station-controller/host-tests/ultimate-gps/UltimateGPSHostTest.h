@@ -0,0 +1,51 @@
+/*
+ * File : UltimateGPSHostTest.h
+ *
+ * Purpose : access to the internals of the UltimateGPS NMEA parser and decoders for the host tests (friend class of UltimateGPS)
+ *
+ * Author : Previmeteo (www.previmeteo.com)
+ *
+ * Project web site : http://oses.previmeteo.com/
+ *
+ * License: GNU GPL v2 (see License.txt)
+ *
+ * Creation date : 2026/10/19
+ *
+ */
+
+
+
+#ifndef ULTIMATE_GPS_HOST_TEST_h
+#define ULTIMATE_GPS_HOST_TEST_h
+
+
+
+#include "Arduino.h"
+
+#include "Ultimate_GPS.h"
+
+
+
+class UltimateGPSHostTest {
+
+  public:
+
+    static void beginAcquisition(UltimateGPS &gps) { gps.beginAcquisition(); }
+
+    static boolean decodeSentence(UltimateGPS &gps, float accuracyLimit, byte minNumOfSatellites) { return gps.decodeSentence(accuracyLimit, minNumOfSatellites); }
+
+    static long parseFixedPointField(UltimateGPS &gps, char *field, byte numOfDecimals) { return gps.parseFixedPointField(field, numOfDecimals); }
+
+    static long parseCoordinateField(UltimateGPS &gps, char *field) { return gps.parseCoordinateField(field); }
+
+    static byte getSentenceLength(UltimateGPS &gps) { return gps._sentenceLength; }
+
+    static byte getNumOfFields(UltimateGPS &gps) { return gps._numOfFields; }
+
+    static byte getFieldOffset(UltimateGPS &gps, byte fieldIndex) { return gps._fieldOffsets[fieldIndex]; }
+
+};
+
+
+
+#endif
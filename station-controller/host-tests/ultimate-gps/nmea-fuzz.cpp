@@ -0,0 +1,335 @@
+/*
+ * File : nmea-fuzz.cpp
+ *
+ * Purpose : fuzz driver of the UltimateGPS NMEA parser and decoders : encode(), decodeSentence(), parseCoordinateField() and
+ *           parseFixedPointField(), with the address and undefined behavior sanitizers
+ *
+ *           - libFuzzer target (LLVMFuzzerTestOneInput(), built with NMEA_FUZZ_LIBFUZZER defined, see the Makefile)
+ *           - standalone mode (any compiler) : the lines of the given files are mutated (with their checksum fixed up half of
+ *             the time, so that the mutations reach the decoders) and fed to the same target. The given files are also fed
+ *             as they are first, so that a crash input can be replayed
+ *
+ * Usage : nmea-fuzz [-n num of iterations] [-s random seed] <files (NMEA logs, crash inputs)...>
+ *
+ * Checks (abort() on failure) : sentence terminated inside the buffer, fields offsets inside the sentence, and results of the
+ * fixed-point / coordinate parsers representable in the 32 bits long of the AVR (long is 64 bits on the host)
+ *
+ * Author : Previmeteo (www.previmeteo.com)
+ *
+ * Project web site : http://oses.previmeteo.com/
+ *
+ * License: GNU GPL v2 (see License.txt)
+ *
+ * Creation date : 2026/10/19
+ *
+ */
+
+
+
+#include <stdint.h>
+
+#include <stdio.h>
+
+#include <fstream>
+
+#include <random>
+
+#include <sstream>
+
+#include <string>
+
+#include <vector>
+
+#include "Arduino.h"
+
+#include "Ultimate_GPS.h"
+
+#include "UltimateGPSHostTest.h"
+
+
+
+#define GPS_ON_OFF_PIN 2
+
+#define FUZZ_FIELD_BUFFER_SIZE GPS_NMEA_SENTENCE_BUFFER_SIZE
+
+#define FUZZ_DEFAULT_NUM_OF_ITERATIONS 200000
+
+
+
+static void check(bool condition, const char *description, const char *input) {
+
+  if(condition) return;
+
+  fprintf(stderr, "check failed : %s (input \"%s\")\n", description, input);
+
+  abort();
+
+}
+
+
+
+static bool fitsAVRLong(long value) {
+
+  return (value >= INT32_MIN) and (value <= INT32_MAX);
+
+}
+
+
+
+static void fuzzFieldParsers(UltimateGPS &gps, const char *field, byte numOfDecimals) {
+
+  // the parsers read up to the first char which is not part of the number : field is NUL terminated, as the sentence buffer
+
+  char fieldBuffer[FUZZ_FIELD_BUFFER_SIZE];
+
+  strncpy(fieldBuffer, field, FUZZ_FIELD_BUFFER_SIZE - 1);
+  fieldBuffer[FUZZ_FIELD_BUFFER_SIZE - 1] = '\0';
+
+  check(fitsAVRLong(UltimateGPSHostTest::parseFixedPointField(gps, fieldBuffer, numOfDecimals)), "parseFixedPointField() 32 bits range", fieldBuffer);
+
+  check(fitsAVRLong(UltimateGPSHostTest::parseCoordinateField(gps, fieldBuffer)), "parseCoordinateField() 32 bits range", fieldBuffer);
+
+}
+
+
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+
+  // data[0] : accuracy limit (0.1 to 5.0), data[1] : min num of satellites (bits 0-3), num of decimals (bits 4-5),
+  // min fix mode (bits 6-7), then the chars received from the GPS
+
+  if(size < 2) return 0;
+
+  HardwareSerial silentSerial;
+
+  UltimateGPS gps(&silentSerial, GPS_ON_OFF_PIN);
+
+  float accuracyLimit = (data[0] % 50 + 1) / 10.0;
+  byte minNumOfSatellites = data[1] & 0x0F;
+  byte numOfDecimals = (data[1] >> 4) & 0x03;
+
+  gps.setAcquisitionCriteria(data[1] >> 6, (data[0] & 0x80) ? 3.0 : 0);
+
+  UltimateGPSHostTest::beginAcquisition(gps);
+
+  std::string field;
+
+  for(size_t i = 2 ; i < size ; i++) {
+
+    char c = (char) data[i];
+
+    if(gps.encode(c)) {
+
+      char *sentence = gps.getSentence();
+
+      byte sentenceLength = UltimateGPSHostTest::getSentenceLength(gps);
+
+      check(sentenceLength < GPS_NMEA_SENTENCE_BUFFER_SIZE, "sentence length", sentence);
+      check((sentence[0] == '$') and (sentence[sentenceLength] == '\0'), "sentence terminated", sentence);          // a '\0' received is kept in the sentence
+      check(UltimateGPSHostTest::getNumOfFields(gps) <= GPS_NMEA_MAX_NUM_OF_FIELDS, "num of fields", sentence);
+
+      for(byte fieldIndex = 0 ; fieldIndex < UltimateGPSHostTest::getNumOfFields(gps) ; fieldIndex++) {
+
+        check(UltimateGPSHostTest::getFieldOffset(gps, fieldIndex) <= sentenceLength, "field offset", sentence);
+
+      }
+
+      if(UltimateGPSHostTest::decodeSentence(gps, accuracyLimit, minNumOfSatellites)) {
+
+        check(gps.firstPositionAcquired, "first position flag", sentence);
+
+      }
+
+    }
+
+    // the fields parsers are also fed with every field of the raw input, checksum or not
+
+    if((c == ',') or (c == '*') or (c == '\r') or (c == '\n') or (i == (size - 1))) {
+
+      if((c != ',') and (c != '*') and (c != '\r') and (c != '\n')) field += c;
+
+      fuzzFieldParsers(gps, field.c_str(), numOfDecimals);
+
+      field.clear();
+
+    }
+
+    else if(c != '\0') field += c;
+
+  }
+
+  return 0;
+
+}
+
+
+
+#if !defined(NMEA_FUZZ_LIBFUZZER)
+
+
+
+static void fixChecksum(std::string &sentence) {
+
+  size_t starPosition = sentence.rfind('*');
+
+  if((sentence.empty()) or (sentence[0] != '$') or (starPosition == std::string::npos)) return;
+
+  byte checksum = 0;
+
+  for(size_t i = 1 ; i < starPosition ; i++) checksum ^= (byte) sentence[i];
+
+  char hexDigits[3];
+
+  snprintf(hexDigits, sizeof(hexDigits), "%02X", checksum);
+
+  sentence = sentence.substr(0, starPosition + 1) + hexDigits;
+
+}
+
+
+
+static std::string mutate(const std::string &line, std::mt19937 &randomGenerator) {
+
+  static const char alphabet[] = "0123456789.,-*$NSEWAV\r\n";
+
+  std::string mutant = line;
+
+  int numOfMutations = randomGenerator() % 4;
+
+  for(int i = 0 ; i < numOfMutations ; i++) {
+
+    size_t position = mutant.empty() ? 0 : randomGenerator() % (mutant.size() + 1);
+
+    switch(randomGenerator() % 6) {
+
+      case 0 :                                                                 // random byte
+        if(position < mutant.size()) mutant[position] = (char) (randomGenerator() & 0xFF);
+        break;
+
+      case 1 :                                                                 // NMEA char inserted
+        mutant.insert(position, 1, alphabet[randomGenerator() % (sizeof(alphabet) - 1)]);
+        break;
+
+      case 2 :                                                                 // char deleted
+        if(position < mutant.size()) mutant.erase(position, 1);
+        break;
+
+      case 3 :                                                                 // run of digits (long numbers)
+        mutant.insert(position, 1 + randomGenerator() % 24, (char) ('0' + randomGenerator() % 10));
+        break;
+
+      case 4 :                                                                 // field duplicated
+        {
+          size_t fieldEnd = mutant.find(',', position);
+          if(fieldEnd != std::string::npos) mutant.insert(position, mutant.substr(position, fieldEnd - position + 1));
+        }
+        break;
+
+      default :                                                                // truncated
+        mutant.resize(position);
+        break;
+
+    }
+
+  }
+
+  if(randomGenerator() % 2) fixChecksum(mutant);
+
+  return mutant;
+
+}
+
+
+
+static void runInput(const std::string &input) {
+
+  LLVMFuzzerTestOneInput((const uint8_t *) input.data(), input.size());
+
+}
+
+
+
+int main(int argc, char **argv) {
+
+  unsigned long numOfIterations = FUZZ_DEFAULT_NUM_OF_ITERATIONS;
+
+  unsigned long seed = 1;
+
+  std::vector<std::string> lines;
+
+  for(int i = 1 ; i < argc ; i++) {
+
+    std::string argument = argv[i];
+
+    if((argument == "-n") and ((i + 1) < argc)) numOfIterations = strtoul(argv[++i], NULL, 10);
+
+    else if((argument == "-s") and ((i + 1) < argc)) seed = strtoul(argv[++i], NULL, 10);
+
+    else {
+
+      std::ifstream inputFile(argument.c_str(), std::ios::binary);
+
+      if(!inputFile) {
+
+        fprintf(stderr, "%s : cannot be read\n", argument.c_str());
+
+        return 2;
+
+      }
+
+      std::stringstream content;
+
+      content << inputFile.rdbuf();
+
+      runInput(content.str());
+
+      std::string line;
+
+      while(std::getline(content, line)) {
+
+        if(!line.empty() and (line[line.size() - 1] == '\r')) line.erase(line.size() - 1);
+
+        if(!line.empty() and (line[0] != '#')) lines.push_back(line);
+
+      }
+
+    }
+
+  }
+
+  if(lines.empty()) {
+
+    fprintf(stderr, "usage : %s [-n num of iterations] [-s random seed] <files (NMEA logs, crash inputs)...>\n", argv[0]);
+
+    return 2;
+
+  }
+
+  std::mt19937 randomGenerator(seed);
+
+  for(unsigned long iteration = 0 ; iteration < numOfIterations ; iteration++) {
+
+    // 2 parameters bytes, then 1 to 4 mutated lines
+
+    std::string input;
+
+    input += (char) (randomGenerator() & 0xFF);
+    input += (char) (randomGenerator() & 0xFF);
+
+    int numOfLines = 1 + randomGenerator() % 4;
+
+    for(int i = 0 ; i < numOfLines ; i++) input += mutate(lines[randomGenerator() % lines.size()], randomGenerator) + "\r\n";
+
+    runInput(input);
+
+  }
+
+  printf("%lu iterations (seed %lu, %lu seed lines) : no failure\n", numOfIterations, seed, (unsigned long) lines.size());
+
+  return 0;
+
+}
+
+
+
+#endif
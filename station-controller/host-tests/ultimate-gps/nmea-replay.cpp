@@ -0,0 +1,290 @@
+/*
+ * File : nmea-replay.cpp
+ *
+ * Purpose : replay of the NMEA fixture logs through the UltimateGPS library, on a host :
+ *
+ *           - decode check : first fix accepted by acquireNewPosition() against the reference file (exact values)
+ *           - averaging check : distance between the position returned by acquireAveragedPosition() and the reference position
+ *           - time-to-acceptance of both acquisitions (virtual clock, from the first char of the log)
+ *           - parser throughput : sentences / second and chars / second of encode() + decodeSentence() on the host CPU
+ *
+ * Usage : nmea-replay <fixtures directory> [num of throughput passes]
+ *
+ *         the exit status is 1 if a check fails
+ *
+ * Author : Previmeteo (www.previmeteo.com)
+ *
+ * Project web site : http://oses.previmeteo.com/
+ *
+ * License: GNU GPL v2 (see License.txt)
+ *
+ * Creation date : 2026/10/19
+ *
+ */
+
+
+
+#include <stdio.h>
+
+#include <chrono>
+
+#include <fstream>
+
+#include <sstream>
+
+#include <string>
+
+#include "Arduino.h"
+
+#include "ReplaySerial.h"
+
+#include "Ultimate_GPS.h"
+
+#include "UltimateGPSHostTest.h"
+
+
+
+#define GPS_ON_OFF_PIN 2
+
+#define ACQUISITION_TIMEOUT_IN_S 120
+
+#define AVERAGING_MIN_NUM_OF_SATELLITES 4
+#define AVERAGING_MAX_NUM_OF_FIXES 8
+#define AVERAGING_WINDOW_IN_S 20
+#define AVERAGING_CONVERGENCE_RADIUS_IN_CM 50
+
+#define DEFAULT_NUM_OF_THROUGHPUT_PASSES 200
+
+
+
+struct FixtureReference {
+
+  std::string logFileName;
+  unsigned long baudRate;
+  unsigned long updatePeriodInMS;
+  float accuracyLimit;
+
+  long firstFixLatitudeInMicroDegrees;
+  long firstFixLongitudeInMicroDegrees;
+  long firstFixAltitudeInCm;
+  std::string firstFixDate;                                   // ddmmyy
+  std::string firstFixTime;                                   // hhmmss
+
+  long referenceLatitudeInMicroDegrees;
+  long referenceLongitudeInMicroDegrees;
+  long referenceAltitudeInCm;
+  long toleranceInCm;
+
+};
+
+
+
+static std::string twoDigits(byte value) {
+
+  char buffer[4];
+
+  snprintf(buffer, sizeof(buffer), "%02u", value);
+
+  return buffer;
+
+}
+
+
+
+static boolean checkFirstFix(UltimateGPS &gps, FixtureReference &reference) {
+
+  Position &position = gps.position;
+
+  std::string fixDate = twoDigits(position.fix_D_utc) + twoDigits(position.fix_M_utc) + twoDigits(position.fix_Y_utc);
+  std::string fixTime = twoDigits(position.fix_h_utc) + twoDigits(position.fix_m_utc) + twoDigits(position.fix_s_utc);
+
+  boolean ok = (position.latitudeInMicroDegrees == reference.firstFixLatitudeInMicroDegrees)
+               and (position.longitudeInMicroDegrees == reference.firstFixLongitudeInMicroDegrees)
+               and (position.altitudeAboveMSLInCm == reference.firstFixAltitudeInCm)
+               and (fixDate == reference.firstFixDate)
+               and (fixTime == reference.firstFixTime);
+
+  if(!ok) {
+
+    printf("    decoded  : %ld %ld %ld %s %s\n", position.latitudeInMicroDegrees, position.longitudeInMicroDegrees, position.altitudeAboveMSLInCm,
+           fixDate.c_str(), fixTime.c_str());
+
+    printf("    expected : %ld %ld %ld %s %s\n", reference.firstFixLatitudeInMicroDegrees, reference.firstFixLongitudeInMicroDegrees,
+           reference.firstFixAltitudeInCm, reference.firstFixDate.c_str(), reference.firstFixTime.c_str());
+
+  }
+
+  return ok;
+
+}
+
+
+
+static boolean replayFixture(const std::string &fixturesDirectory, FixtureReference &reference, int numOfThroughputPasses) {
+
+  std::string logPath = fixturesDirectory + "/" + reference.logFileName;
+
+  ReplaySerial gpsSerial;
+
+  if(!gpsSerial.load(logPath.c_str(), reference.baudRate, reference.updatePeriodInMS)) {
+
+    printf("%s : cannot be read\n", logPath.c_str());
+
+    return false;
+
+  }
+
+  printf("%s : %lu lines, %lu update periods, %lu bauds\n", reference.logFileName.c_str(), gpsSerial.getNumOfLines(), gpsSerial.getNumOfPeriods(),
+         reference.baudRate);
+
+  boolean ok = true;
+
+
+  // single fix
+
+  hostResetClock();
+  gpsSerial.rewind();
+
+  UltimateGPS gps(&gpsSerial, GPS_ON_OFF_PIN);
+
+  boolean acquired = gps.acquireNewPosition(reference.accuracyLimit, ACQUISITION_TIMEOUT_IN_S);
+
+  boolean decodeOK = acquired and checkFirstFix(gps, reference);
+
+  printf("  acquireNewPosition()      : %s, time to acceptance %lu ms, time to first fix %lu ms, decode %s\n",
+         acquired ? "acquired" : "TIMEOUT", millis(), gps.timeToFirstFixInMS, decodeOK ? "OK" : "FAILED");
+
+  ok = ok and decodeOK;
+
+
+  // averaged position
+
+  hostResetClock();
+  gpsSerial.rewind();
+
+  UltimateGPS averagingGPS(&gpsSerial, GPS_ON_OFF_PIN);
+
+  acquired = averagingGPS.acquireAveragedPosition(reference.accuracyLimit, AVERAGING_MIN_NUM_OF_SATELLITES, AVERAGING_MAX_NUM_OF_FIXES,
+                                                  AVERAGING_WINDOW_IN_S, AVERAGING_CONVERGENCE_RADIUS_IN_CM, ACQUISITION_TIMEOUT_IN_S);
+
+  float distanceInCm = averagingGPS.getDistanceInCm(averagingGPS.position.latitudeInMicroDegrees, averagingGPS.position.longitudeInMicroDegrees,
+                                                    reference.referenceLatitudeInMicroDegrees, reference.referenceLongitudeInMicroDegrees);
+
+  boolean averagingOK = acquired and (distanceInCm <= reference.toleranceInCm);
+
+  printf("  acquireAveragedPosition() : %s, time to acceptance %lu ms, %u fixes averaged, %.0f cm from the reference (max %ld cm) %s\n",
+         acquired ? "acquired" : "TIMEOUT", millis(), averagingGPS.position.numOfAveragedFixes, distanceInCm, reference.toleranceInCm,
+         averagingOK ? "OK" : "FAILED");
+
+  ok = ok and averagingOK;
+
+
+  // throughput : the whole log, decoded as fast as the host can
+
+  const std::string &chars = gpsSerial.getChars();
+
+  UltimateGPS throughputGPS(&gpsSerial, GPS_ON_OFF_PIN);
+
+  UltimateGPSHostTest::beginAcquisition(throughputGPS);
+
+  unsigned long numOfSentences = 0;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  for(int pass = 0 ; pass < numOfThroughputPasses ; pass++) {
+
+    for(size_t i = 0 ; i < chars.size() ; i++) {
+
+      if(throughputGPS.encode(chars[i])) {
+
+        UltimateGPSHostTest::decodeSentence(throughputGPS, reference.accuracyLimit, 0);
+
+        numOfSentences++;
+
+      }
+
+    }
+
+  }
+
+  double elapsedInS = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if(elapsedInS > 0) {
+
+    printf("  throughput                : %.0f sentences/s, %.0f chars/s (%lu valid sentences per pass)\n",
+           numOfSentences / elapsedInS, (double) chars.size() * numOfThroughputPasses / elapsedInS, numOfSentences / numOfThroughputPasses);
+
+  }
+
+  return ok;
+
+}
+
+
+
+int main(int argc, char **argv) {
+
+  if(argc < 2) {
+
+    printf("usage : %s <fixtures directory> [num of throughput passes]\n", argv[0]);
+
+    return 2;
+
+  }
+
+  std::string fixturesDirectory = argv[1];
+
+  int numOfThroughputPasses = (argc > 2) ? atoi(argv[2]) : DEFAULT_NUM_OF_THROUGHPUT_PASSES;
+
+  if(numOfThroughputPasses < 1) numOfThroughputPasses = 1;
+
+  std::ifstream referencesFile((fixturesDirectory + "/reference-positions.txt").c_str());
+
+  if(!referencesFile) {
+
+    printf("%s/reference-positions.txt : cannot be read\n", fixturesDirectory.c_str());
+
+    return 2;
+
+  }
+
+  int numOfFixtures = 0;
+  int numOfFailures = 0;
+
+  std::string line;
+
+  while(std::getline(referencesFile, line)) {
+
+    if(line.empty() or (line[0] == '#')) continue;
+
+    FixtureReference reference;
+
+    std::istringstream fields(line);
+
+    fields >> reference.logFileName >> reference.baudRate >> reference.updatePeriodInMS >> reference.accuracyLimit
+           >> reference.firstFixLatitudeInMicroDegrees >> reference.firstFixLongitudeInMicroDegrees >> reference.firstFixAltitudeInCm
+           >> reference.firstFixDate >> reference.firstFixTime
+           >> reference.referenceLatitudeInMicroDegrees >> reference.referenceLongitudeInMicroDegrees >> reference.referenceAltitudeInCm
+           >> reference.toleranceInCm;
+
+    if(!fields) {
+
+      printf("reference-positions.txt : malformed line \"%s\"\n", line.c_str());
+
+      numOfFailures++;
+
+      continue;
+
+    }
+
+    numOfFixtures++;
+
+    if(!replayFixture(fixturesDirectory, reference, numOfThroughputPasses)) numOfFailures++;
+
+  }
+
+  printf("%d fixture(s), %d failure(s)\n", numOfFixtures, numOfFailures);
+
+  return ((numOfFixtures > 0) and (numOfFailures == 0)) ? 0 : 1;
+
+}
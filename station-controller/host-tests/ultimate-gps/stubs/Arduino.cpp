@@ -0,0 +1,172 @@
+/*
+ * File : Arduino.cpp (host stub)
+ *
+ * Purpose : virtual clock, pins and Print implementation of the host stub (see Arduino.h)
+ *
+ * Author : Previmeteo (www.previmeteo.com)
+ *
+ * Project web site : http://oses.previmeteo.com/
+ *
+ * License: GNU GPL v2 (see License.txt)
+ *
+ * Creation date : 2026/10/19
+ *
+ */
+
+
+
+#include <stdio.h>
+
+#include "Arduino.h"
+
+#include "SoftwareSerial.h"
+
+
+
+static unsigned long long virtualMicros = 0;
+
+
+
+unsigned long long hostMicros() {
+
+  return virtualMicros;
+
+}
+
+
+
+void hostAdvanceMicros(unsigned long long us) {
+
+  virtualMicros += us;
+
+}
+
+
+
+void hostResetClock() {
+
+  virtualMicros = 0;
+
+}
+
+
+
+unsigned long millis() {
+
+  return (unsigned long) (virtualMicros / 1000);
+
+}
+
+
+
+unsigned long micros() {
+
+  return (unsigned long) virtualMicros;
+
+}
+
+
+
+void delay(unsigned long ms) {
+
+  virtualMicros += (unsigned long long) ms * 1000;
+
+}
+
+
+
+void delayMicroseconds(unsigned int us) {
+
+  virtualMicros += us;
+
+}
+
+
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+void digitalWrite(uint8_t pin, uint8_t value) {}
+
+int digitalRead(uint8_t pin) { return LOW; }
+
+
+
+char *ultoa(unsigned long value, char *buffer, int radix) {
+
+  sprintf(buffer, (radix == HEX) ? "%lX" : "%lu", value);
+
+  return buffer;
+
+}
+
+
+
+char *ltoa(long value, char *buffer, int radix) {
+
+  sprintf(buffer, (radix == HEX) ? "%lX" : "%ld", value);
+
+  return buffer;
+
+}
+
+
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+
+  size_t n = 0;
+
+  while(size--) n += write(*buffer++);
+
+  return n;
+
+}
+
+
+
+size_t Print::print(const __FlashStringHelper *str) { return print(reinterpret_cast<const char *>(str)); }
+
+size_t Print::print(const char *str) { return write(str); }
+
+size_t Print::print(char c) { return write((uint8_t) c); }
+
+size_t Print::print(unsigned char n, int base) { return print((unsigned long) n, base); }
+
+size_t Print::print(int n, int base) { return print((long) n, base); }
+
+size_t Print::print(unsigned int n, int base) { return print((unsigned long) n, base); }
+
+size_t Print::print(long n, int base) { char buffer[24]; return write(ltoa(n, buffer, base)); }
+
+size_t Print::print(unsigned long n, int base) { char buffer[24]; return write(ultoa(n, buffer, base)); }
+
+size_t Print::print(double n, int digits) { char buffer[32]; snprintf(buffer, sizeof(buffer), "%.*f", digits, n); return write(buffer); }
+
+size_t Print::println(const __FlashStringHelper *str) { return print(str) + println(); }
+
+size_t Print::println(const char *str) { return print(str) + println(); }
+
+size_t Print::println(char c) { return print(c) + println(); }
+
+size_t Print::println(unsigned char n, int base) { return print(n, base) + println(); }
+
+size_t Print::println(int n, int base) { return print(n, base) + println(); }
+
+size_t Print::println(unsigned int n, int base) { return print(n, base) + println(); }
+
+size_t Print::println(long n, int base) { return print(n, base) + println(); }
+
+size_t Print::println(unsigned long n, int base) { return print(n, base) + println(); }
+
+size_t Print::println(double n, int digits) { return print(n, digits) + println(); }
+
+size_t Print::println() { return write("\r\n"); }
+
+
+
+size_t SoftwareSerial::write(uint8_t c) {
+
+  putchar(c);
+
+  return 1;
+
+}
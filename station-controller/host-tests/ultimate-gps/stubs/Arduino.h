@@ -0,0 +1,166 @@
+/*
+ * File : Arduino.h (host stub)
+ *
+ * Purpose : the subset of the Arduino 1.0 core used by the Ultimate_GPS and SpanTrace libraries, for a host (PC) build
+ *
+ * Author : Previmeteo (www.previmeteo.com)
+ *
+ * Project web site : http://oses.previmeteo.com/
+ *
+ * License: GNU GPL v2 (see License.txt)
+ *
+ * Creation date : 2026/10/19
+ *
+ * Notes :
+ *
+ * - millis() / micros() read a virtual clock : it only moves with delay() / delayMicroseconds(), hostAdvanceMicros() and
+ *   the serial stand-ins (see ReplaySerial.h), so that a replay does not depend on the speed of the host
+ * - long is 64 bits on a 64 bits host (32 bits on the AVR) : the host tests check the 32 bits ranges themselves
+ *
+ */
+
+
+
+#ifndef HOST_STUB_ARDUINO_h
+#define HOST_STUB_ARDUINO_h
+
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+
+#define HIGH 1
+#define LOW 0
+
+#define INPUT 0
+#define OUTPUT 1
+
+#define DEC 10
+#define HEX 16
+
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+
+
+class __FlashStringHelper;
+
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+
+
+void pinMode(uint8_t pin, uint8_t mode);
+
+void digitalWrite(uint8_t pin, uint8_t value);
+
+int digitalRead(uint8_t pin);
+
+
+unsigned long millis();
+
+unsigned long micros();
+
+void delay(unsigned long ms);
+
+void delayMicroseconds(unsigned int us);
+
+
+char *ultoa(unsigned long value, char *buffer, int radix);
+
+char *ltoa(long value, char *buffer, int radix);
+
+
+
+// host only : virtual clock
+
+unsigned long long hostMicros();
+
+void hostAdvanceMicros(unsigned long long us);
+
+void hostResetClock();
+
+
+
+
+class Print {
+
+  public:
+
+    virtual size_t write(uint8_t c) = 0;
+
+    virtual size_t write(const uint8_t *buffer, size_t size);
+
+    size_t write(const char *str) { return write((const uint8_t *) str, strlen(str)); }
+
+    size_t print(const __FlashStringHelper *str);
+    size_t print(const char *str);
+    size_t print(char c);
+    size_t print(unsigned char n, int base = DEC);
+    size_t print(int n, int base = DEC);
+    size_t print(unsigned int n, int base = DEC);
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println(const __FlashStringHelper *str);
+    size_t println(const char *str);
+    size_t println(char c);
+    size_t println(unsigned char n, int base = DEC);
+    size_t println(int n, int base = DEC);
+    size_t println(unsigned int n, int base = DEC);
+    size_t println(long n, int base = DEC);
+    size_t println(unsigned long n, int base = DEC);
+    size_t println(double n, int digits = 2);
+    size_t println();
+
+};
+
+
+
+
+class Stream : public Print {
+
+  public:
+
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() = 0;
+
+};
+
+
+
+
+class HardwareSerial : public Stream {
+
+  // silent stand-in : nothing is received, the sent chars are dropped (see ReplaySerial.h for a NMEA log player)
+
+  public:
+
+    virtual void begin(unsigned long baudRate) {}
+    virtual void end() {}
+
+    virtual int available() { return 0; }
+    virtual int read() { return -1; }
+    virtual int peek() { return -1; }
+    virtual void flush() {}
+
+    virtual size_t write(uint8_t c) { return 1; }
+
+    using Print::write;
+
+};
+
+
+
+#endif
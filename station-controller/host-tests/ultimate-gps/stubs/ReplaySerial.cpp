@@ -0,0 +1,193 @@
+/*
+ * File : ReplaySerial.cpp (host stub)
+ *
+ * Purpose : HardwareSerial stand-in playing a NMEA log at the timing of the receiver (see ReplaySerial.h)
+ *
+ * Author : Previmeteo (www.previmeteo.com)
+ *
+ * Project web site : http://oses.previmeteo.com/
+ *
+ * License: GNU GPL v2 (see License.txt)
+ *
+ * Creation date : 2026/10/19
+ *
+ */
+
+
+
+#include <fstream>
+
+#include "ReplaySerial.h"
+
+
+
+ReplaySerial::ReplaySerial() {
+
+  _numOfLines = 0;
+
+  _numOfPeriods = 0;
+
+  _nextCharIndex = 0;
+
+  _startMicros = 0;
+
+}
+
+
+
+boolean ReplaySerial::load(const char *fileName, unsigned long baudRate, unsigned long updatePeriodInMS) {
+
+  std::ifstream log(fileName, std::ios::binary);
+
+  if(!log) return false;
+
+  _chars.clear();
+  _arrivalMicros.clear();
+
+  _numOfLines = 0;
+  _numOfPeriods = 0;
+
+  double charDurationInMicros = 10 * 1000000.0 / baudRate;                 // start bit, 8 data bits, stop bit
+
+  std::string periodFormatter;
+
+  double arrivalMicros = 0;
+
+  std::string line;
+
+  while(std::getline(log, line)) {
+
+    if(!line.empty() and (line[line.size() - 1] == '\r')) line.erase(line.size() - 1);
+
+    if(line.empty() or (line[0] == '#')) continue;
+
+    std::string formatter = (line.size() >= 6) ? line.substr(3, 3) : "";
+
+    if(periodFormatter.empty() and (line.compare(0, 2, "$P") != 0)) periodFormatter = formatter;          // proprietary sentences ($PMTK...) skipped
+
+    if(!periodFormatter.empty() and (formatter == periodFormatter)) {
+
+      double periodStartMicros = (double) _numOfPeriods * updatePeriodInMS * 1000;
+
+      if(arrivalMicros < periodStartMicros) arrivalMicros = periodStartMicros;
+
+      _numOfPeriods++;
+
+    }
+
+    line += "\r\n";
+
+    for(size_t i = 0 ; i < line.size() ; i++) {
+
+      arrivalMicros += charDurationInMicros;
+
+      _chars += line[i];
+      _arrivalMicros.push_back((unsigned long long) arrivalMicros);
+
+    }
+
+    _numOfLines++;
+
+  }
+
+  rewind();
+
+  return true;
+
+}
+
+
+
+void ReplaySerial::rewind() {
+
+  _nextCharIndex = 0;
+
+  _startMicros = hostMicros();
+
+}
+
+
+
+const std::string &ReplaySerial::getChars() {
+
+  return _chars;
+
+}
+
+
+
+unsigned long ReplaySerial::getNumOfLines() {
+
+  return _numOfLines;
+
+}
+
+
+
+unsigned long ReplaySerial::getNumOfPeriods() {
+
+  return _numOfPeriods;
+
+}
+
+
+
+boolean ReplaySerial::isExhausted() {
+
+  return (_nextCharIndex >= _chars.size());
+
+}
+
+
+
+int ReplaySerial::available() {
+
+  if(isExhausted()) {
+
+    hostAdvanceMicros(1000);
+
+    return 0;
+
+  }
+
+  unsigned long long nextArrivalMicros = _startMicros + _arrivalMicros[_nextCharIndex];
+
+  if(hostMicros() < nextArrivalMicros) hostAdvanceMicros(nextArrivalMicros - hostMicros());
+
+  size_t numOfReceivedChars = 0;
+
+  while(((_nextCharIndex + numOfReceivedChars) < _chars.size()) and ((_startMicros + _arrivalMicros[_nextCharIndex + numOfReceivedChars]) <= hostMicros())) numOfReceivedChars++;
+
+  return (int) numOfReceivedChars;
+
+}
+
+
+
+int ReplaySerial::read() {
+
+  if(isExhausted() or ((_startMicros + _arrivalMicros[_nextCharIndex]) > hostMicros())) return -1;
+
+  return (unsigned char) _chars[_nextCharIndex++];
+
+}
+
+
+
+int ReplaySerial::peek() {
+
+  if(isExhausted() or ((_startMicros + _arrivalMicros[_nextCharIndex]) > hostMicros())) return -1;
+
+  return (unsigned char) _chars[_nextCharIndex];
+
+}
+
+
+
+size_t ReplaySerial::write(uint8_t c) {
+
+  // the PMTK commands sent to the receiver are dropped
+
+  return 1;
+
+}
@@ -0,0 +1,88 @@
+/*
+ * File : ReplaySerial.h (host stub)
+ *
+ * Purpose : HardwareSerial stand-in playing a NMEA log at the timing of the receiver (update period, baud rate)
+ *
+ * Author : Previmeteo (www.previmeteo.com)
+ *
+ * Project web site : http://oses.previmeteo.com/
+ *
+ * License: GNU GPL v2 (see License.txt)
+ *
+ * Creation date : 2026/10/19
+ *
+ * Notes :
+ *
+ * - log format : one sentence per line, "\r\n" appended on replay, lines starting with '#' and empty lines ignored. The other
+ *   lines (truncated or corrupted sentences included) are sent as they are
+ * - a new update period starts with each line of the same formatter as the first NMEA line of the log (GGA for the MT3339
+ *   receivers, the proprietary sentences ($PMTK...) are not taken into account),
+ *   the chars of a period are sent back to back at the baud rate (10 bits per char) from the start of the period
+ * - available() with no char received yet moves the virtual clock to the arrival of the next char, as the RX interrupt wakes up
+ *   the AVR from its idle sleep. Once the log has been played, each call moves the clock by 1 ms (so that the timeouts expire)
+ *
+ */
+
+
+
+#ifndef HOST_STUB_REPLAY_SERIAL_h
+#define HOST_STUB_REPLAY_SERIAL_h
+
+
+
+#include <string>
+
+#include <vector>
+
+#include "Arduino.h"
+
+
+
+class ReplaySerial : public HardwareSerial {
+
+  public:
+
+    ReplaySerial();
+
+    boolean load(const char *fileName, unsigned long baudRate, unsigned long updatePeriodInMS);
+
+    void rewind();                                             // the log is played again, from the current virtual time
+
+    const std::string &getChars();
+
+    unsigned long getNumOfLines();
+
+    unsigned long getNumOfPeriods();
+
+    boolean isExhausted();
+
+    int available();
+
+    int read();
+
+    int peek();
+
+    size_t write(uint8_t c);
+
+    using Print::write;
+
+
+  private:
+
+    std::string _chars;
+
+    std::vector<unsigned long long> _arrivalMicros;            // from the start of the replay
+
+    unsigned long _numOfLines;
+
+    unsigned long _numOfPeriods;
+
+    size_t _nextCharIndex;
+
+    unsigned long long _startMicros;
+
+};
+
+
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * File : SoftwareSerial.h (host stub)
+ *
+ * Purpose : debug connection stand-in for a host (PC) build : the printed chars go to the standard output
+ *
+ * Author : Previmeteo (www.previmeteo.com)
+ *
+ * Project web site : http://oses.previmeteo.com/
+ *
+ * License: GNU GPL v2 (see License.txt)
+ *
+ * Creation date : 2026/10/19
+ *
+ */
+
+
+
+#ifndef HOST_STUB_SOFTWARE_SERIAL_h
+#define HOST_STUB_SOFTWARE_SERIAL_h
+
+
+
+#include "Arduino.h"
+
+
+
+class SoftwareSerial : public Stream {
+
+  public:
+
+    SoftwareSerial(uint8_t receivePin, uint8_t transmitPin, bool inverseLogic = false) {}
+
+    void begin(long speed) {}
+    void end() {}
+
+    bool listen() { return true; }
+    bool isListening() { return true; }
+    bool overflow() { return false; }
+
+    int available() { return 0; }
+    int read() { return -1; }
+    int peek() { return -1; }
+    void flush() {}
+
+    size_t write(uint8_t c);
+
+    using Print::write;
+
+};
+
+
+
+#endif
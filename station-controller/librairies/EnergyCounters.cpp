@@ -0,0 +1,120 @@
+/*
+ * File : EnergyCounters.cpp
+ *
+ * Version : 0.8.0
+ *
+ * Purpose : on time counters of the station's subsystems (modem, GPS, sensors...), persisted in the internal EEPROM, for Arduino
+ *
+ * Author : Previmeteo (www.previmeteo.com)
+ *
+ * Project web site : http://oses.previmeteo.com/
+ *
+ * License: GNU GPL v2 (see License.txt)
+ *
+ * Creation date : 2026/10/19
+ *
+ */
+
+
+
+
+#include "Arduino.h"
+
+#include <avr/eeprom.h>
+
+#include "EnergyCounters.h"
+
+
+
+
+EnergyCounters::EnergyCounters() {
+
+  _numOfCounters = 0;
+
+}
+
+
+
+void EnergyCounters::init(byte numOfCounters, int eepromAddress) {
+
+  // the counters are loaded from the EEPROM (reset if the entry has never been written), the references start at 0 (boot)
+
+  _numOfCounters = numOfCounters;
+
+  if(_numOfCounters > ENERGY_COUNTERS_MAX_NUM_OF_COUNTERS) _numOfCounters = ENERGY_COUNTERS_MAX_NUM_OF_COUNTERS;
+
+  _eepromAddress = eepromAddress;
+
+  eeprom_read_block((void *) &_counters, (const void *) _eepromAddress, sizeof(_counters));
+
+  if(_counters.signature != ENERGY_COUNTERS_EEPROM_SIGNATURE) reset();
+
+  for(byte i = 0 ; i < ENERGY_COUNTERS_MAX_NUM_OF_COUNTERS ; i++) {
+
+    _onTimesRemaindersInMS[i] = 0;
+
+    _lastReferenceTimesInMS[i] = 0;
+
+  }
+
+}
+
+
+
+void EnergyCounters::update(byte counterIndex, unsigned long referenceTimeInMS) {
+
+  if(counterIndex >= _numOfCounters) return;
+
+  unsigned long incrementInMS = referenceTimeInMS - _lastReferenceTimesInMS[counterIndex];
+
+  _lastReferenceTimesInMS[counterIndex] = referenceTimeInMS;
+
+  incrementInMS += _onTimesRemaindersInMS[counterIndex];
+
+  _counters.onTimesInS[counterIndex] += incrementInMS / 1000;
+
+  _onTimesRemaindersInMS[counterIndex] = incrementInMS % 1000;
+
+}
+
+
+
+unsigned long EnergyCounters::getOnTimeInS(byte counterIndex) {
+
+  if(counterIndex >= _numOfCounters) return 0;
+
+  return _counters.onTimesInS[counterIndex];
+
+}
+
+
+
+unsigned long EnergyCounters::getChargeInTenthsOfMAh(byte counterIndex, unsigned int currentInMA) {
+
+  // charge = on time (s) * current (mA) / 3600, computed in two parts to avoid an overflow of the product
+
+  unsigned long onTimeInS = getOnTimeInS(counterIndex);
+
+  return (onTimeInS / 360) * currentInMA + ((onTimeInS % 360) * currentInMA + 180) / 360;
+
+}
+
+
+
+void EnergyCounters::save() {
+
+  eeprom_write_block((const void *) &_counters, (void *) _eepromAddress, sizeof(_counters));
+
+}
+
+
+
+void EnergyCounters::reset() {
+
+  _counters.signature = ENERGY_COUNTERS_EEPROM_SIGNATURE;
+
+  for(byte i = 0 ; i < ENERGY_COUNTERS_MAX_NUM_OF_COUNTERS ; i++) _counters.onTimesInS[i] = 0;
+
+  save();
+
+}
@@ -0,0 +1,89 @@
+/*
+ * File : EnergyCounters.h
+ *
+ * Version : 0.8.0
+ *
+ * Purpose : on time counters of the station's subsystems (modem, GPS, sensors...), persisted in the internal EEPROM, for Arduino
+ *
+ * Author : Previmeteo (www.previmeteo.com)
+ *
+ * Project web site : http://oses.previmeteo.com/
+ *
+ * License: GNU GPL v2 (see License.txt)
+ *
+ * Creation date : 2026/10/19
+ *
+ */
+
+
+
+
+#ifndef ENERGY_COUNTERS_h
+#define ENERGY_COUNTERS_h
+
+
+
+#include "Arduino.h"
+
+
+
+
+#define ENERGY_COUNTERS_MAX_NUM_OF_COUNTERS 6
+
+#define ENERGY_COUNTERS_EEPROM_SIGNATURE 0x4543                   // "EC"
+
+
+
+
+struct EnergyCountersEEPROMEntry {
+
+  unsigned int signature;                                         // ENERGY_COUNTERS_EEPROM_SIGNATURE if the entry has been written
+  unsigned long onTimesInS[ENERGY_COUNTERS_MAX_NUM_OF_COUNTERS];
+
+};
+
+
+
+
+class EnergyCounters {
+
+  // each counter follows a cumulative, millis() based, time in ms (e.g. millis() itself for the MCU awake time, or the power on time
+  // measured by a driver) : only the increments since the previous update are added, so that the reference can wrap around or restart
+  // at 0 after a reset
+
+
+  public:
+
+    EnergyCounters();
+
+    void init(byte numOfCounters, int eepromAddress);
+
+    void update(byte counterIndex, unsigned long referenceTimeInMS);
+
+    unsigned long getOnTimeInS(byte counterIndex);
+
+    unsigned long getChargeInTenthsOfMAh(byte counterIndex, unsigned int currentInMA);
+
+    void save();
+
+    void reset();
+
+
+  private:
+
+    EnergyCountersEEPROMEntry _counters;
+
+    unsigned int _onTimesRemaindersInMS[ENERGY_COUNTERS_MAX_NUM_OF_COUNTERS];
+
+    unsigned long _lastReferenceTimesInMS[ENERGY_COUNTERS_MAX_NUM_OF_COUNTERS];
+
+    byte _numOfCounters;
+
+    int _eepromAddress;
+
+
+};
+
+
+
+#endif
@@ -1,7 +1,7 @@
 /*
  * File : GPRSbee.cpp
  *
- * Version : 0.8.1
+ * Version : 0.8.13
  *
  * Purpose : GPRSBEE modem (http://www.gprsbee.com) interface library for Arduino
  *
@@ -16,6 +16,20 @@
  * History :
  * 
  * - 0.8.1 : bug fix in the requestAT() method
+ * - 0.8.2 : DNS resolution cache (AT+CDNSGIP), stored in RAM and EEPROM, for the tcpConnect() method
+ * - 0.8.3 : alternative HTTP transport based on the modem's built-in HTTP stack (AT+HTTPINIT / HTTPDATA / HTTPACTION / HTTPREAD)
+ * - 0.8.4 : serial link baud rate negotiation (AT+IPR) persisted in EEPROM, HardwareSerial backend
+ * - 0.8.5 : multi-connection mode (AT+CIPMUX=1) : concurrent TCP connections, per link transmissions and responses
+ * - 0.8.6 : cumulative power on time (powerOnTimeInMS), measured by togglePowerState()
+ * - 0.8.7 : spans tracing (see SpanTrace.h) : requestAT(), tcpConnect()
+ * - 0.8.8 : the SoftwareSerial connection to the modem is supplied by the caller (as the HardwareSerial one)
+ * - 0.8.9 : multi-connection mode : the links events ("<link>, CONNECT OK", "+RECEIVE,<link>" + status line) are parsed by a single 
+ *           reader fed with every received char while links are tracked, instead of being flushed with the AT responses
+ * - 0.8.10 : powerOnTimeInMS : a modem found on (at boot...) and powered off without a power on seen by togglePowerState() is not counted
+ * - 0.8.11 : retrieveIncomingCharsFromLineToLine() / retrieveHttpResponseBodyFromLineToLine() : RX buffer polled without the 100 ms pauses
+ *            (responses longer than the 64 bytes SoftwareSerial buffer were truncated at the negotiated baud rates)
+ * - 0.8.12 : TCP transport : the Content-Length of the posted file is computed by getHttpPostFileBodyLength() (was 1 byte short)
+ * - 0.8.13 : getHttpStackMaxDataLength() : max body length which can be input in the AT+HTTPDATA window at the current baud rate
  * 
  */
  
@@ -25,21 +39,92 @@
 
 #include "SoftwareSerial.h"
 
+#include <avr/eeprom.h>
+
 #include "GPRSbee.h"
 
+#include "SpanTrace.h"
+
+
+
+GPRSbee::GPRSbee(byte onOffPin, byte statusPin, SoftwareSerial *softwareSerialConnection):serialConnection(*softwareSerialConnection) { 
+    
+  _onOffPin = onOffPin;
+  _statusPin = statusPin;
+  _debugSerialConnectionEnabled = false;
+  
+  _softwareSerialConnection = softwareSerialConnection;
+  _hardwareSerialConnection = NULL;
+  
+  _dnsCacheEnabled = false;
+  _baudRateNegotiationEnabled = false;
+  
+  _multiConnectionModeEnabled = false;
+  _tcpLinkNum = 0;
+  _trackedLinkMask = 0;
+  _linkEventLineLength = 0;
+  _receivingLinkNum = -1;
+  
+  powerOnTimeInMS = 0;
+  _powerOnMS = 0;
+  
+}
+
+
 
+GPRSbee::GPRSbee(byte onOffPin, byte statusPin, SoftwareSerial *softwareSerialConnection, SoftwareSerial *debugSerialConnection):serialConnection(*softwareSerialConnection) { 
+    
+  _onOffPin = onOffPin;
+  _statusPin = statusPin;
+  _debugSerialConnectionEnabled = true;
+  
+  _debugSerialConnection = debugSerialConnection;
+  
+  _softwareSerialConnection = softwareSerialConnection;
+  _hardwareSerialConnection = NULL;
+  
+  _dnsCacheEnabled = false;
+  _baudRateNegotiationEnabled = false;
+  
+  _multiConnectionModeEnabled = false;
+  _tcpLinkNum = 0;
+  _trackedLinkMask = 0;
+  _linkEventLineLength = 0;
+  _receivingLinkNum = -1;
+  
+  powerOnTimeInMS = 0;
+  _powerOnMS = 0;
+  
+}
 
-GPRSbee::GPRSbee(byte onOffPin, byte statusPin, byte rxPin, byte txPin):serialConnection(rxPin, txPin) { 
+
+
+GPRSbee::GPRSbee(byte onOffPin, byte statusPin, HardwareSerial *hardwareSerialConnection):serialConnection(*hardwareSerialConnection) { 
     
   _onOffPin = onOffPin;
   _statusPin = statusPin;
   _debugSerialConnectionEnabled = false;
   
+  _softwareSerialConnection = NULL;
+  _hardwareSerialConnection = hardwareSerialConnection;
+  
+  _dnsCacheEnabled = false;
+  _baudRateNegotiationEnabled = false;
+  
+  _multiConnectionModeEnabled = false;
+  _tcpLinkNum = 0;
+  _trackedLinkMask = 0;
+  _linkEventLineLength = 0;
+  _receivingLinkNum = -1;
+  
+  powerOnTimeInMS = 0;
+  _powerOnMS = 0;
+  
 }
 
 
 
-GPRSbee::GPRSbee(byte onOffPin, byte statusPin, byte rxPin, byte txPin, SoftwareSerial *debugSerialConnection):serialConnection(rxPin, txPin) { 
+GPRSbee::GPRSbee(byte onOffPin, byte statusPin, HardwareSerial *hardwareSerialConnection, SoftwareSerial *debugSerialConnection):serialConnection(*hardwareSerialConnection) { 
     
   _onOffPin = onOffPin;
   _statusPin = statusPin;
@@ -47,6 +132,21 @@ GPRSbee::GPRSbee(byte onOffPin, byte statusPin, byte rxPin, byte txPin, Software
   
   _debugSerialConnection = debugSerialConnection;
   
+  _softwareSerialConnection = NULL;
+  _hardwareSerialConnection = hardwareSerialConnection;
+  
+  _dnsCacheEnabled = false;
+  _baudRateNegotiationEnabled = false;
+  
+  _multiConnectionModeEnabled = false;
+  _tcpLinkNum = 0;
+  _trackedLinkMask = 0;
+  _linkEventLineLength = 0;
+  _receivingLinkNum = -1;
+  
+  powerOnTimeInMS = 0;
+  _powerOnMS = 0;
+  
 }
 
 
@@ -58,8 +158,7 @@ void GPRSbee::init(long baudRate) {
   
   pinMode(_statusPin, INPUT);  
   
-  serialConnection.begin(baudRate);
-  serialConnection.listen();
+  beginSerialConnection(baudRate);
   
   delay(1000);
 
@@ -67,12 +166,338 @@ void GPRSbee::init(long baudRate) {
 
 
 
+void GPRSbee::beginSerialConnection(long baudRate) {
+  
+  if(_hardwareSerialConnection != NULL) {
+    
+    _hardwareSerialConnection->begin(baudRate);
+    
+  }
+  
+  else {
+  
+    _softwareSerialConnection->begin(baudRate);
+    _softwareSerialConnection->listen();
+    
+  }
+  
+  _baudRate = baudRate;
+  
+}
+
+
+
+void GPRSbee::flushRxBuffer() {
+  
+  // HardwareSerial::flush() only waits for the end of the transmission (Arduino 1.0+) : the received chars are discarded "by hand"
+  // (the links events they hold are still parsed, see readIncomingChar())
+  
+  while(serialConnection.available() > 0) readIncomingChar();
+  
+}
+
+
+
+char GPRSbee::readIncomingChar() {
+  
+  // every char received from the modem is read here : while TCP links are tracked (multi-connection mode), the chars are also fed 
+  // to the links events reader, whatever the command whose response is being read (or flushed)
+  
+  char c = serialConnection.read();
+  
+  if(_trackedLinkMask != 0) processLinkEventChar(c);
+  
+  return c;
+  
+}
+
+
+
+void GPRSbee::processLinkEventChar(char c) {
+  
+  // the line is assembled across the successive reads (the chars which don't fit in the buffer are dropped), the "> " prompt of 
+  // AT+CIPSEND (not followed by a new line) is dropped as well
+  
+  if((c == ' ') && (_linkEventLineLength == 1) && (_linkEventLineBuffer[0] == '>')) _linkEventLineLength = 0;
+  
+  else if(c == '\n') {
+    
+    _linkEventLineBuffer[_linkEventLineLength] = '\0';
+    
+    processLinkEventLine();
+    
+    _linkEventLineLength = 0;
+    
+  }
+  
+  else if((c != '\r') && (_linkEventLineLength < (TCP_LINK_EVENT_LINE_BUFFER_SIZE - 1))) {
+    
+    _linkEventLineBuffer[_linkEventLineLength] = c;
+    _linkEventLineLength++;
+    
+  }
+  
+}
+
+
+
+void GPRSbee::processLinkEventLine() {
+  
+  // expected lines : "<link>, CONNECT OK", "<link>, CONNECT FAIL", "<link>, ALREADY CONNECT", and "+RECEIVE,<link>,<length>:" 
+  // followed by the data received : the first data line received on a link is the status line of the HTTP response
+  
+  if(_linkEventLineLength == 0) return;
+  
+  if(_receivingLinkNum >= 0) {
+    
+    byte linkNum = _receivingLinkNum;
+    
+    _receivingLinkNum = -1;
+    
+    if(!(_respondedLinkMask & (1 << linkNum)) && (strncmp(_linkEventLineBuffer, "HTTP/", 5) == 0)) {
+      
+      char *statusCodePtr = strchr(_linkEventLineBuffer, ' ');
+      
+      _httpResponseStatusCodes[linkNum] = (statusCodePtr != NULL) ? atoi(statusCodePtr + 1) : 0;
+      
+      _respondedLinkMask |= (1 << linkNum);
+      
+      return;
+      
+    }
+    
+  }
+  
+  if(strncmp(_linkEventLineBuffer, "+RECEIVE,", 9) == 0) {
+    
+    byte linkNum = _linkEventLineBuffer[9] - '0';
+    
+    if((linkNum < TCP_MAX_NUM_OF_LINKS) && (_trackedLinkMask & (1 << linkNum))) _receivingLinkNum = linkNum;
+    
+    return;
+    
+  }
+  
+  byte linkNum = _linkEventLineBuffer[0] - '0';
+  
+  if((linkNum < TCP_MAX_NUM_OF_LINKS) && (_linkEventLineBuffer[1] == ',') && (_trackedLinkMask & (1 << linkNum))) {
+    
+    if((strstr(_linkEventLineBuffer, "CONNECT OK") != NULL) || (strstr(_linkEventLineBuffer, "ALREADY") != NULL)) _connectedLinkMask |= (1 << linkNum);
+    
+    if(strstr(_linkEventLineBuffer, "CONNECT") != NULL) _connectResultLinkMask |= (1 << linkNum);
+    
+  }
+  
+}
+
+
+
+long GPRSbee::getBaudRate() {
+  
+  return _baudRate;
+  
+}
+
+
+
+void GPRSbee::enableBaudRateNegotiation(long maxBaudRate, int eepromAddress) {
+  
+  // maxBaudRate : the fastest rate the serial backend can reliably receive (SoftwareSerial at 8 MHz : 38400)
+  // the rate negotiated during a previous session is stored in the modem's profile and in the EEPROM, so that we can talk to
+  // the modem at this rate right after its power on
+  
+  _maxBaudRate = maxBaudRate;
+  _baudRateEEPROMAddress = eepromAddress;
+  
+  BaudRateEntry baudRateEntry;
+  
+  eeprom_read_block((void *) &baudRateEntry, (const void *) _baudRateEEPROMAddress, sizeof(baudRateEntry));
+  
+  if((baudRateEntry.marker == SERIAL_CONNECTION_BAUD_RATE_MARKER) && (baudRateEntry.baudRate > 0) && (baudRateEntry.baudRate != _baudRate)) {
+    
+    beginSerialConnection(baudRateEntry.baudRate);
+    
+  }
+  
+  _baudRateNegotiationEnabled = true;
+  
+}
+
+
+
+long GPRSbee::negotiateBaudRate() {
+  
+  // must be called once the modem is on and the communication activated : returns the baud rate of the serial link
+  //
+  // - if the modem doesn't answer at the expected rate (new modem, profile reset...), we look for its rate, then restore the autobaud mode
+  // - we then try the rates from the fastest (up to _maxBaudRate) to the slowest : each rate is validated with a "long" response (IMEI)
+  //   before being saved in the modem's profile (AT&W) and in the EEPROM
+  
+  long candidateBaudRates[] = {115200, 57600, 38400, 19200};
+  
+  if(!_baudRateNegotiationEnabled) return _baudRate;
+  
+  if(!isCommunicationActivated()) {
+    
+    boolean modemFound = false;
+    
+    for(byte i = 0 ; (i < sizeof(candidateBaudRates) / sizeof(long)) && !modemFound ; i++) {
+      
+      beginSerialConnection(candidateBaudRates[i]);
+      
+      activateCommunication();
+      
+      modemFound = isCommunicationActivated();
+      
+    }
+    
+    if(modemFound) {
+      
+      requestAT(F("AT+IPR=0"), 2, AT_IPR_RESP_TIMOUT_IN_MS);                // autobaud mode
+      
+      requestAT(F("AT&W"), 2, AT_DEFAULT_RESP_TIMOUT_IN_MS);
+      
+    }
+    
+    beginSerialConnection(SERIAL_CONNECTION_DEFAULT_BAUD_RATE);
+    
+    activateCommunication();
+    
+    saveBaudRate(0);
+    
+  }
+  
+  if(isCommunicationActivated() && (_baudRate < _maxBaudRate)) {
+    
+    boolean baudRateNegotiated = false;
+    
+    long initialBaudRate = _baudRate;
+    
+    for(byte i = 0 ; (i < sizeof(candidateBaudRates) / sizeof(long)) && !baudRateNegotiated ; i++) {
+      
+      if((candidateBaudRates[i] <= _maxBaudRate) && (candidateBaudRates[i] > initialBaudRate)) {
+        
+        baudRateNegotiated = requestBaudRate(candidateBaudRates[i]);
+        
+      }
+      
+    }
+    
+    if(baudRateNegotiated) {
+      
+      requestAT(F("AT&W"), 2, AT_DEFAULT_RESP_TIMOUT_IN_MS);
+      
+      saveBaudRate(_baudRate);
+      
+    }
+    
+  }
+  
+  return _baudRate;
+  
+}
+
+
+
+boolean GPRSbee::requestBaudRate(long baudRate) {
+  
+  // returns true if the modem and the MCU now communicate reliably at the requested rate : if not, both are switched back to 
+  // the autobaud mode at the default rate
+  
+  boolean success = false;
+  
+  char baudRateBuffer[12];
+  
+  ltoa(baudRate, baudRateBuffer, 10);
+  
+  requestAT(F("AT+IPR="), baudRateBuffer, F(""), 2, AT_IPR_RESP_TIMOUT_IN_MS);            // the "OK" response is sent at the current rate
+  
+  if(strstr(_atRxBuffer, "OK") != NULL) {
+    
+    beginSerialConnection(baudRate);
+    
+    delay(100);
+    
+    success = isCommunicationReliable();
+    
+    if(!success) {
+      
+      // the chars sent by the MCU are usually still understood by the modem, even when its responses are garbled
+      
+      serialConnection.print(F("AT+IPR=0\r\n"));
+      
+      delay(500);
+      
+      beginSerialConnection(SERIAL_CONNECTION_DEFAULT_BAUD_RATE);
+      
+      activateCommunication();
+      
+    }
+    
+  }
+  
+  return success;
+  
+}
+
+
+
+boolean GPRSbee::isCommunicationReliable() {
+  
+  boolean reliable = true;
+  
+  for(byte i = 0 ; (i < 3) && reliable ; i++) reliable = isCommunicationActivated();
+  
+  if(reliable) {
+    
+    char IMEIBuffer[16];
+    
+    retrieveIMEI(IMEIBuffer);
+    
+    for(byte i = 0 ; i < 15 ; i++) {
+      
+      if((IMEIBuffer[i] < '0') || (IMEIBuffer[i] > '9')) reliable = false;
+      
+    }
+    
+  }
+  
+  return reliable;
+  
+}
+
+
+
+void GPRSbee::saveBaudRate(long baudRate) {
+  
+  BaudRateEntry baudRateEntry;
+  
+  eeprom_read_block((void *) &baudRateEntry, (const void *) _baudRateEEPROMAddress, sizeof(baudRateEntry));
+  
+  if((baudRateEntry.marker != SERIAL_CONNECTION_BAUD_RATE_MARKER) || (baudRateEntry.baudRate != baudRate)) {
+    
+    baudRateEntry.marker = SERIAL_CONNECTION_BAUD_RATE_MARKER;
+    baudRateEntry.baudRate = baudRate;
+    
+    eeprom_write_block((const void *) &baudRateEntry, (void *) _baudRateEEPROMAddress, sizeof(baudRateEntry));
+    
+  }
+  
+}
+
+
+
 void GPRSbee::togglePowerState() {
   
+  // the power on time is counted from the beginning of the power on sequence to the end of the power off sequence. A modem found 
+  // on without a power on seen by the library (_powerOnMS = 0 : on at boot...) is not counted when it is powered off
+  
   boolean success = false;
   
   boolean powerStateInit = isOn();
   
+  unsigned long toggleStartMS = millis();
+  
   for(byte i=0 ; (i<3) && !success ; i++) {
 
     digitalWrite(_onOffPin, LOW);
@@ -90,6 +515,16 @@ void GPRSbee::togglePowerState() {
     if(isOn() == !powerStateInit) success = true;
     
   }
+  
+  if(success and !powerStateInit) _powerOnMS = toggleStartMS;
+  
+  else if(success and powerStateInit) {
+    
+    if(_powerOnMS != 0) powerOnTimeInMS += millis() - _powerOnMS;
+    
+    _powerOnMS = 0;
+    
+  }
     
 }
 
@@ -298,27 +733,365 @@ boolean GPRSbee::isConnectedToNet() {
 
 
 
-boolean GPRSbee::tcpConnect(char *serverName, char *serverPort, byte maxNumConnectAttempts) {
+void GPRSbee::enableDNSCache(int eepromAddress, unsigned long ttlInS) {
   
-  boolean connected = false;
+  // the cache entry is loaded once from the EEPROM, then kept in RAM : the EEPROM is only written when a new resolution occurs
   
-  char connectRequestBuffer[50];
+  _dnsCacheEEPROMAddress = eepromAddress;
+  _dnsCacheTTLInS = ttlInS;
   
-  strcpy(connectRequestBuffer, "AT+CIPSTART=\"TCP\",\"");
-  strcat(connectRequestBuffer, serverName);
-  strcat(connectRequestBuffer, "\",\"");
-  strcat(connectRequestBuffer, serverPort);
-  strcat(connectRequestBuffer, "\"");
+  eeprom_read_block((void *) &_dnsCache, (const void *) _dnsCacheEEPROMAddress, sizeof(_dnsCache));
   
-  for(byte attemptsConnect = 0 ; (attemptsConnect < maxNumConnectAttempts) && !connected ; attemptsConnect++) {
-      
-    requestAT(connectRequestBuffer, 4, AT_CIPSTART_RESP_TIMOUT_IN_MS);
-      
-    if(strstr(_atRxBuffer, "CONN") != NULL) connected = true;              // expected response : "CONNECT OK"
+  if(_dnsCache.marker != DNS_CACHE_MARKER) {
+    
+    _dnsCache.marker = 0;
+    _dnsCache.hostNameHash = 0;
+    _dnsCache.ipAddress[0] = '\0';
+    _dnsCache.expirationTimestamp = 0;
     
   }
   
-  return connected;
+  _dnsCache.ipAddress[DNS_CACHE_IP_ADDRESS_BUFFER_SIZE - 1] = '\0';
+  
+  _dnsCacheEnabled = true;
+  
+}
+
+
+
+boolean GPRSbee::resolveHostName(char *hostName, char *ipAddressBuffer) {
+  
+  // ipAddressBuffer must be at least DNS_CACHE_IP_ADDRESS_BUFFER_SIZE chars long
+  // expected response : "OK" then, once resolved, "+CDNSGIP: 1,"www.host.com","xxx.xxx.xxx.xxx"" (or "+CDNSGIP: 0,<error code>")
+  
+  boolean resolved = false;
+  
+  char incomingCharsBuffer[90];
+  
+  if(DEBUG_MODE and _debugSerialConnectionEnabled) {
+  
+    _debugSerialConnection->print("-> AT+CDNSGIP=");
+    _debugSerialConnection->println(hostName);
+  
+  }
+  
+  delay(150);
+  
+  flushRxBuffer();
+  
+  serialConnection.print(F("AT+CDNSGIP=\""));
+  serialConnection.print(hostName);
+  serialConnection.print(F("\"\r\n"));
+  
+  retrieveIncomingCharsFromLineToLine(incomingCharsBuffer, sizeof(incomingCharsBuffer), 0, 3, AT_CDNSGIP_RESP_TIMOUT_IN_MS);
+  
+  if(DEBUG_MODE and _debugSerialConnectionEnabled) {
+  
+    _debugSerialConnection->println(incomingCharsBuffer);
+  
+  }
+  
+  char *resultPtr = strstr(incomingCharsBuffer, "+CDNSGIP: 1");
+  
+  if(resultPtr != NULL) {
+    
+    // the IP address is the content of the second quoted field
+    
+    byte numOfQuotes = 0;
+    byte ipAddressLength = 0;
+    boolean ipAddressComplete = false;
+    boolean ipAddressValid = true;
+    
+    for(char *c = resultPtr ; (*c != '\0') && !ipAddressComplete && ipAddressValid ; c++) {
+      
+      if(*c == '"') {
+        
+        numOfQuotes++;
+        
+        if(numOfQuotes == 4) ipAddressComplete = true;
+        
+      }
+      
+      else if(numOfQuotes == 3) {
+        
+        if((ipAddressLength < (DNS_CACHE_IP_ADDRESS_BUFFER_SIZE - 1)) && (((*c >= '0') && (*c <= '9')) || (*c == '.'))) {
+          
+          ipAddressBuffer[ipAddressLength] = *c;
+          ipAddressLength++;
+          
+        }
+        
+        else ipAddressValid = false;
+        
+      }
+      
+    }
+    
+    ipAddressBuffer[ipAddressLength] = '\0';
+    
+    if(ipAddressComplete && ipAddressValid && (ipAddressLength >= 7)) resolved = true;
+    
+  }
+  
+  if(!resolved) ipAddressBuffer[0] = '\0';
+  
+  return resolved;
+  
+}
+
+
+
+unsigned int GPRSbee::getHostNameHash(char *hostName) {
+  
+  // djb2 string hash, only used to detect a change of the host name between two resolutions (a new firmware for example)
+  
+  unsigned int hash = 5381;
+  
+  for(byte i = 0 ; hostName[i] != '\0' ; i++) hash = ((hash << 5) + hash) + hostName[i];
+  
+  return hash;
+  
+}
+
+
+
+void GPRSbee::saveDNSCache() {
+  
+  eeprom_write_block((const void *) &_dnsCache, (void *) _dnsCacheEEPROMAddress, sizeof(_dnsCache));
+  
+}
+
+
+
+boolean GPRSbee::tcpConnect(char *serverName, char *serverPort, byte maxNumConnectAttempts, unsigned long timestampNow) {
+  
+  // same as tcpConnect(serverName, serverPort, maxNumConnectAttempts) but the server name is resolved once, with the help of the DNS cache,
+  // then the connection is opened with the IP address : if the connection fails, the cache entry is invalidated and we fall back to the 
+  // server name for the remaining attempts
+  // timestampNow (seconds since 01 Jan 1970 00:00:00 GMT) may be 0 if the current time is unknown : the cache is then bypassed
+  
+  boolean connected = false;
+  
+  byte numConnectAttemptsLeft = maxNumConnectAttempts;
+  
+  if(_dnsCacheEnabled && (timestampNow > 0) && (maxNumConnectAttempts > 0)) {
+    
+    char ipAddress[DNS_CACHE_IP_ADDRESS_BUFFER_SIZE];
+    
+    boolean ipAddressAvailable = false;
+    
+    unsigned int hostNameHash = getHostNameHash(serverName);
+    
+    if((_dnsCache.marker == DNS_CACHE_MARKER) && (_dnsCache.hostNameHash == hostNameHash) && (_dnsCache.ipAddress[0] != '\0') 
+       && (timestampNow < _dnsCache.expirationTimestamp)) {
+      
+      strcpy(ipAddress, _dnsCache.ipAddress);
+      
+      ipAddressAvailable = true;
+      
+    }
+    
+    else if(resolveHostName(serverName, ipAddress)) {
+      
+      _dnsCache.marker = DNS_CACHE_MARKER;
+      _dnsCache.hostNameHash = hostNameHash;
+      strcpy(_dnsCache.ipAddress, ipAddress);
+      _dnsCache.expirationTimestamp = timestampNow + _dnsCacheTTLInS;
+      
+      saveDNSCache();
+      
+      ipAddressAvailable = true;
+      
+    }
+    
+    if(ipAddressAvailable) {
+      
+      connected = tcpConnect(ipAddress, serverPort, 1);
+      
+      numConnectAttemptsLeft--;
+      
+      if(!connected) {
+        
+        _dnsCache.ipAddress[0] = '\0';
+        
+        saveDNSCache();
+        
+        if(numConnectAttemptsLeft == 0) numConnectAttemptsLeft = 1;
+        
+      }
+      
+    }
+    
+  }
+  
+  if(!connected && (numConnectAttemptsLeft > 0)) connected = tcpConnect(serverName, serverPort, numConnectAttemptsLeft);
+  
+  return connected;
+  
+}
+
+
+
+boolean GPRSbee::tcpConnect(char *serverName, char *serverPort, byte maxNumConnectAttempts) {
+  
+  // in multi-connection mode, the connection is opened on the link selected with selectTcpLink()
+  
+  TRACE_SPAN(TRACE_EVENT_TCP_CONNECT);
+  
+  boolean connected = false;
+  
+  char connectRequestBuffer[52];
+  
+  buildTcpConnectRequest(connectRequestBuffer, _tcpLinkNum, serverName, serverPort);
+  
+  for(byte attemptsConnect = 0 ; (attemptsConnect < maxNumConnectAttempts) && !connected ; attemptsConnect++) {
+      
+    requestAT(connectRequestBuffer, 4, AT_CIPSTART_RESP_TIMOUT_IN_MS);
+      
+    if(strstr(_atRxBuffer, "CONN") != NULL) connected = true;              // expected response : "CONNECT OK" (or "<link>, CONNECT OK")
+    
+  }
+  
+  return connected;
+  
+}
+
+
+
+void GPRSbee::buildTcpConnectRequest(char *connectRequestBuffer, byte linkNum, char *serverName, char *serverPort) {
+  
+  strcpy(connectRequestBuffer, "AT+CIPSTART=");
+  
+  if(_multiConnectionModeEnabled) {
+    
+    byte linkNumPos = strlen(connectRequestBuffer);
+    
+    connectRequestBuffer[linkNumPos] = '0' + linkNum;
+    connectRequestBuffer[linkNumPos + 1] = ',';
+    connectRequestBuffer[linkNumPos + 2] = '\0';
+    
+  }
+  
+  strcat(connectRequestBuffer, "\"TCP\",\"");
+  strcat(connectRequestBuffer, serverName);
+  strcat(connectRequestBuffer, "\",\"");
+  strcat(connectRequestBuffer, serverPort);
+  strcat(connectRequestBuffer, "\"");
+  
+}
+
+
+
+void GPRSbee::enableMultiConnectionMode() {
+  
+  // must be called before the connectToNet() call (the modem only accepts AT+CIPMUX in the "IP INITIAL" state)
+  
+  requestAT(F("AT+CIPMUX=1"), 2, AT_DEFAULT_RESP_TIMOUT_IN_MS);
+  
+  if(strstr(_atRxBuffer, "OK") != NULL) _multiConnectionModeEnabled = true;
+  
+}
+
+
+
+boolean GPRSbee::isMultiConnectionModeEnabled() {
+  
+  return _multiConnectionModeEnabled;
+  
+}
+
+
+
+void GPRSbee::selectTcpLink(byte linkNum) {
+  
+  // the following tcpConnect(), tcpSendBegin() and tcpClose() calls apply to this link (multi-connection mode only)
+  
+  if(linkNum < TCP_MAX_NUM_OF_LINKS) _tcpLinkNum = linkNum;
+  
+}
+
+
+
+void GPRSbee::tcpConnectStart(byte linkNum, char *serverName, char *serverPort) {
+  
+  // multi-connection mode : the connection is only requested here, without waiting for the "<link>, CONNECT OK" result, 
+  // so that several connections can be established at the same time (see waitForTcpConnect()). The link is tracked from now on, 
+  // and the RX buffer is not flushed : a quick result of a previous request must not be lost
+  
+  if(linkNum >= TCP_MAX_NUM_OF_LINKS) return;
+  
+  char connectRequestBuffer[52];
+  
+  buildTcpConnectRequest(connectRequestBuffer, linkNum, serverName, serverPort);
+  
+  _trackedLinkMask |= (1 << linkNum);
+  
+  _connectResultLinkMask &= ~(1 << linkNum);
+  _connectedLinkMask &= ~(1 << linkNum);
+  _respondedLinkMask &= ~(1 << linkNum);
+  
+  if(DEBUG_MODE and _debugSerialConnectionEnabled) {
+  
+    _debugSerialConnection->print("-> ");
+    _debugSerialConnection->println(connectRequestBuffer);
+  
+  }
+  
+  serialConnection.print(connectRequestBuffer); 
+  serialConnection.print("\r\n");  
+  
+  retrieveATResponse(2, AT_DEFAULT_RESP_TIMOUT_IN_MS);
+  
+}
+
+
+
+byte GPRSbee::waitForTcpConnect(byte linkMask, boolean waitForAllLinks, long timeOutInMS) {
+  
+  // returns the mask of the links (bit n for link n) of linkMask which are connected when :
+  // - the first connection has been established (waitForAllLinks = false) 
+  // - all the connections have been established or have failed (waitForAllLinks = true)
+  // - the timeout has expired
+  // the results already received (e.g. during the following tcpConnectStart() call) are taken into account
+  
+  unsigned long clockTimeOut = millis() + timeOutInMS;
+  
+  while(millis() < clockTimeOut) {
+    
+    if((_connectResultLinkMask & linkMask) == linkMask) break;
+    
+    if(!waitForAllLinks && (_connectedLinkMask & linkMask)) break;
+    
+    if(serialConnection.available() > 0) readIncomingChar();
+    
+  }
+  
+  byte connectedLinkMask = _connectedLinkMask & linkMask;
+  
+  if(DEBUG_MODE and _debugSerialConnectionEnabled) {
+  
+    _debugSerialConnection->print("connected links : ");
+    _debugSerialConnection->println(connectedLinkMask, BIN);
+  
+  }
+  
+  return connectedLinkMask;
+  
+}
+
+
+
+void GPRSbee::tcpSendBegin() {
+  
+  if(_multiConnectionModeEnabled) {
+    
+    char linkNumBuffer[2] = {(char) ('0' + _tcpLinkNum), '\0'};
+    
+    requestAT(F("AT+CIPSEND="), linkNumBuffer, F(""), 2, AT_CIPSEND_RESP_TIMOUT_IN_MS);
+    
+  }
+  
+  else requestAT(F("AT+CIPSEND"), 2, AT_CIPSEND_RESP_TIMOUT_IN_MS);
   
 }
 
@@ -328,7 +1101,7 @@ void GPRSbee::tcpSendChars(char *chars) {
 
   delay(300);
 
-  requestAT(F("AT+CIPSEND"), 2, AT_CIPSEND_RESP_TIMOUT_IN_MS);
+  tcpSendBegin();
   
   serialConnection.print(chars);
     
@@ -339,8 +1112,18 @@ void GPRSbee::tcpSendChars(char *chars) {
 
 
 void GPRSbee::tcpClose() {
+  
+  if(_multiConnectionModeEnabled) {
+    
+    char linkNumBuffer[2] = {(char) ('0' + _tcpLinkNum), '\0'};
+    
+    requestAT(F("AT+CIPCLOSE="), linkNumBuffer, F(""), 2, AT_CIPCLOSE_RESP_TIMOUT_IN_MS);
+    
+    _trackedLinkMask &= ~(1 << _tcpLinkNum);
+    
+  }
 
-  requestAT(F("AT+CIPCLOSE"), 2, AT_CIPCLOSE_RESP_TIMOUT_IN_MS);
+  else requestAT(F("AT+CIPCLOSE"), 2, AT_CIPCLOSE_RESP_TIMOUT_IN_MS);
 
 }
 
@@ -374,23 +1157,15 @@ void GPRSbee::echoHttpPostURLEncodedRequestAdditionalHeaders(long encodedDataLen
 
 void GPRSbee::echoHttpPostFileRequestAdditionalHeadersPart1(long fileContentLength, char *formFieldName) {
 
-  long formFieldNameLength = 0;
-  while(formFieldName[formFieldNameLength] != '\0') formFieldNameLength++;
-  
-  char boundary[] = HTTP_POST_FILE_BOUNDARY; 
-  long boundaryLength = 0;
-  while(boundary[boundaryLength] != '\0') boundaryLength++;
+  // the Content-Length is computed by getHttpPostFileBodyLength(), as for the HTTP stack transport (same body)
     
   serialConnection.print(F("Content-Type: multipart/form-data; boundary="));
-  serialConnection.print(boundary);
+  serialConnection.print(HTTP_POST_FILE_BOUNDARY);
   serialConnection.print(F("\r\nContent-Length: "));
-  serialConnection.print((95 + formFieldNameLength + 2 * boundaryLength + fileContentLength));
-  serialConnection.print(F("\r\n\r\n--")); 
-  serialConnection.print(HTTP_POST_FILE_BOUNDARY);   
-  serialConnection.print(F("\r\nContent-Disposition: form-data; name=\""));
-  serialConnection.print(formFieldName);
-  serialConnection.print(F("\"; filename=\"none\"\r\n"));
-  serialConnection.print(F("Content-Type: text/plain\r\n\r\n"));
+  serialConnection.print(getHttpPostFileBodyLength(fileContentLength, formFieldName));
+  serialConnection.print(F("\r\n\r\n")); 
+  
+  echoHttpPostFileBodyPart1(formFieldName);
 
 }
 
@@ -418,7 +1193,7 @@ boolean GPRSbee::httpGet(char *serverName, char *serverPort, char *serverURL, by
   
     char httpResponseStatusLineBuffer[60];
     
-    requestAT(F("AT+CIPSEND"), 2, AT_CIPSEND_RESP_TIMOUT_IN_MS);
+    tcpSendBegin();
 
     echoHttpRequestInitHeaders(serverName, serverURL, "GET");
   
@@ -456,7 +1231,7 @@ boolean GPRSbee::httpPostEncodedData(char *serverName, char *serverPort, char *s
   
     char httpResponseStatusLineBuffer[60];
 
-    requestAT(F("AT+CIPSEND"), 2, AT_CIPSEND_RESP_TIMOUT_IN_MS);
+    tcpSendBegin();
 
     echoHttpRequestInitHeaders(serverName, serverURL, "POST");
     
@@ -501,7 +1276,7 @@ boolean GPRSbee::httpPostTextFile(char *serverName, char *serverPort, char *serv
     char formFieldName[] = HTTP_POST_FILE_DEFAULT_FORM_FIELD_NAME;
     
      
-    requestAT(F("AT+CIPSEND"), 2, AT_CIPSEND_RESP_TIMOUT_IN_MS);
+    tcpSendBegin();
     
     echoHttpRequestInitHeaders(serverName, serverURL, "POST");
     
@@ -513,7 +1288,7 @@ boolean GPRSbee::httpPostTextFile(char *serverName, char *serverPort, char *serv
     delay(300);
     
       
-    requestAT(F("AT+CIPSEND"), 2, AT_CIPSEND_RESP_TIMOUT_IN_MS);
+    tcpSendBegin();
     
     serialConnection.print(fileContent);
     
@@ -523,7 +1298,7 @@ boolean GPRSbee::httpPostTextFile(char *serverName, char *serverPort, char *serv
     delay(300);
     
     
-    requestAT(F("AT+CIPSEND"), 2, AT_CIPSEND_RESP_TIMOUT_IN_MS);
+    tcpSendBegin();
     
     echoHttpPostFileRequestAdditionalHeadersPart2();  
    
@@ -544,6 +1319,326 @@ boolean GPRSbee::httpPostTextFile(char *serverName, char *serverPort, char *serv
 
 
 
+void GPRSbee::connectBearer(char *networkAPN, char *username, char *password) {
+  
+  // bearer profile 1, used by the modem's built-in HTTP stack (independent from the AT+CSTT / AT+CIICR context used by the TCP commands)
+  
+  requestAT(F("AT+SAPBR=3,1,\"CONTYPE\",\"GPRS\""), 2, AT_DEFAULT_RESP_TIMOUT_IN_MS);
+  
+  requestAT(F("AT+SAPBR=3,1,\"APN\",\""), networkAPN, F("\""), 2, AT_DEFAULT_RESP_TIMOUT_IN_MS);
+  
+  requestAT(F("AT+SAPBR=3,1,\"USER\",\""), username, F("\""), 2, AT_DEFAULT_RESP_TIMOUT_IN_MS);
+  
+  requestAT(F("AT+SAPBR=3,1,\"PWD\",\""), password, F("\""), 2, AT_DEFAULT_RESP_TIMOUT_IN_MS);
+  
+  requestAT(F("AT+SAPBR=1,1"), 2, AT_SAPBR_RESP_TIMOUT_IN_MS);
+  
+}
+
+
+
+void GPRSbee::disconnectBearer() {
+  
+  requestAT(F("AT+SAPBR=0,1"), 2, AT_SAPBR_RESP_TIMOUT_IN_MS);
+  
+}
+
+
+
+boolean GPRSbee::isBearerConnected() {
+  
+  boolean bearerConnected = false;
+  
+  requestAT(F("AT+SAPBR=2,1"), 2, AT_DEFAULT_RESP_TIMOUT_IN_MS);
+  
+  if(strstr(_atRxBuffer, "+SAPBR: 1,1") != NULL) bearerConnected = true;         // expected response : "+SAPBR: 1,1,"xxx.xxx.xxx.xxx""
+  
+  return bearerConnected;
+  
+}
+
+
+
+boolean GPRSbee::httpStackBegin(char *serverName, char *serverPort, char *serverURL, char *contentType) {
+  
+  // returns true if the HTTP service has been initialized and all its parameters have been accepted by the modem
+  
+  boolean success = true;
+  
+  requestAT(F("AT+HTTPINIT"), 2, AT_DEFAULT_RESP_TIMOUT_IN_MS);
+  
+  if(strstr(_atRxBuffer, "OK") == NULL) {
+    
+    // the service may still be initialized after a previous failure
+    
+    httpStackEnd();
+    
+    requestAT(F("AT+HTTPINIT"), 2, AT_DEFAULT_RESP_TIMOUT_IN_MS);
+    
+    if(strstr(_atRxBuffer, "OK") == NULL) success = false;
+    
+  }
+  
+  if(success) {
+  
+    requestAT(F("AT+HTTPPARA=\"CID\",1"), 2, AT_DEFAULT_RESP_TIMOUT_IN_MS);
+    
+    if(strstr(_atRxBuffer, "OK") == NULL) success = false;
+    
+  }
+  
+  if(success) {
+    
+    if(DEBUG_MODE and _debugSerialConnectionEnabled) {
+    
+      _debugSerialConnection->print("-> AT+HTTPPARA=\"URL\",\"http://");
+      _debugSerialConnection->print(serverName);
+      _debugSerialConnection->print(":");
+      _debugSerialConnection->print(serverPort);
+      _debugSerialConnection->print(serverURL);
+      _debugSerialConnection->println("\"");
+    
+    }
+    
+    delay(150);
+    
+    flushRxBuffer();
+    
+    serialConnection.print(F("AT+HTTPPARA=\"URL\",\"http://"));
+    serialConnection.print(serverName);
+    serialConnection.print(F(":"));
+    serialConnection.print(serverPort);
+    serialConnection.print(serverURL);
+    serialConnection.print(F("\"\r\n"));
+    
+    retrieveATResponse(2, AT_DEFAULT_RESP_TIMOUT_IN_MS);
+    
+    if(strstr(_atRxBuffer, "OK") == NULL) success = false;
+    
+  }
+  
+  if(success && (contentType != NULL)) {
+    
+    requestAT(F("AT+HTTPPARA=\"CONTENT\",\""), contentType, F("\""), 2, AT_DEFAULT_RESP_TIMOUT_IN_MS);
+    
+    if(strstr(_atRxBuffer, "OK") == NULL) success = false;
+    
+  }
+  
+  return success;
+  
+}
+
+
+
+boolean GPRSbee::httpStackLoadDataBegin(long dataLength) {
+  
+  // returns true if the modem is ready to receive the request body : exactly dataLength chars must then be written
+  // to serialConnection before the httpStackLoadDataEnd() call
+  
+  boolean readyToLoadData = false;
+  
+  char dataLengthBuffer[12];
+  
+  ltoa(dataLength, dataLengthBuffer, 10);
+  
+  requestAT(F("AT+HTTPDATA="), dataLengthBuffer, F(",120000"), 2, AT_HTTPDATA_RESP_TIMOUT_IN_MS);         // HTTP_STACK_DATA_INPUT_WINDOW_IN_MS allowed to input the data
+  
+  if(strstr(_atRxBuffer, "DOWNLOAD") != NULL) readyToLoadData = true;              // expected response : "DOWNLOAD"
+  
+  return readyToLoadData;
+  
+}
+
+
+
+boolean GPRSbee::httpStackLoadDataEnd() {
+  
+  boolean dataLoaded = false;
+  
+  char incomingCharsBuffer[20];
+  
+  retrieveIncomingCharsFromLineToLine(incomingCharsBuffer, sizeof(incomingCharsBuffer), 0, 1, AT_HTTPDATA_RESP_TIMOUT_IN_MS);
+  
+  if(strstr(incomingCharsBuffer, "OK") != NULL) dataLoaded = true;
+  
+  return dataLoaded;
+  
+}
+
+
+
+int GPRSbee::httpStackAction(byte action, long timeOutInMS) {
+  
+  // returns the HTTP status code of the response (0 if no response has been received before the timeout)
+  // expected response : "OK" then, once the server has responded, "+HTTPACTION:<action>,<status code>,<body length>"
+  
+  int httpStatusCode = 0;
+  
+  char incomingCharsBuffer[40];
+  
+  if(DEBUG_MODE and _debugSerialConnectionEnabled) {
+  
+    _debugSerialConnection->print("-> AT+HTTPACTION=");
+    _debugSerialConnection->println(action);
+  
+  }
+  
+  delay(150);
+  
+  flushRxBuffer();
+  
+  serialConnection.print(F("AT+HTTPACTION="));
+  serialConnection.print(action);
+  serialConnection.print(F("\r\n"));
+  
+  retrieveIncomingCharsFromLineToLine(incomingCharsBuffer, sizeof(incomingCharsBuffer), 0, 3, timeOutInMS);
+  
+  if(DEBUG_MODE and _debugSerialConnectionEnabled) {
+  
+    _debugSerialConnection->println(incomingCharsBuffer);
+  
+  }
+  
+  char *resultPtr = strstr(incomingCharsBuffer, "+HTTPACTION:");
+  
+  if(resultPtr != NULL) {
+    
+    resultPtr = strchr(resultPtr, ',');
+    
+    if(resultPtr != NULL) httpStatusCode = atoi(resultPtr + 1);
+    
+  }
+  
+  return httpStatusCode;
+  
+}
+
+
+
+void GPRSbee::httpStackReadResponseBody(char *httpResponseBodyBuffer, byte httpResponseBodyBufferLength) {
+  
+  // only the (httpResponseBodyBufferLength - 1) first chars of the first line of the body are transfered from the modem
+  // expected response : "+HTTPREAD:<data length>", then the data, then "OK"
+  
+  char dataLengthBuffer[4];
+  
+  itoa(httpResponseBodyBufferLength - 1, dataLengthBuffer, 10);
+  
+  if(DEBUG_MODE and _debugSerialConnectionEnabled) {
+  
+    _debugSerialConnection->print("-> AT+HTTPREAD=0,");
+    _debugSerialConnection->println(dataLengthBuffer);
+  
+  }
+  
+  delay(150);
+  
+  flushRxBuffer();
+  
+  serialConnection.print(F("AT+HTTPREAD=0,"));
+  serialConnection.print(dataLengthBuffer);
+  serialConnection.print(F("\r\n"));
+  
+  retrieveIncomingCharsFromLineToLine(httpResponseBodyBuffer, httpResponseBodyBufferLength, 2, 2, AT_HTTPREAD_RESP_TIMOUT_IN_MS);
+  
+}
+
+
+
+void GPRSbee::httpStackEnd() {
+  
+  requestAT(F("AT+HTTPTERM"), 2, AT_DEFAULT_RESP_TIMOUT_IN_MS);
+  
+}
+
+
+
+boolean GPRSbee::httpStackPostTextFile(char *serverName, char *serverPort, char *serverURL, char *fileContent) {
+  
+  // same as httpPostTextFile(), with the modem's built-in HTTP stack : the bearer must have been connected before (see connectBearer())
+  // returns true if the HTTP status code of the response is 200 
+  
+  boolean requestSuccess = false; 
+  
+  long fileContentLength = 0;
+  while(fileContent[fileContentLength] != '\0') fileContentLength++;
+  
+  char formFieldName[] = HTTP_POST_FILE_DEFAULT_FORM_FIELD_NAME;
+  
+  char contentType[] = "multipart/form-data; boundary=" HTTP_POST_FILE_BOUNDARY;
+  
+  if(httpStackBegin(serverName, serverPort, serverURL, contentType)) {
+    
+    if(httpStackLoadDataBegin(getHttpPostFileBodyLength(fileContentLength, formFieldName))) {
+      
+      echoHttpPostFileBodyPart1(formFieldName);
+      
+      serialConnection.print(fileContent);
+      
+      echoHttpPostFileRequestAdditionalHeadersPart2();
+      
+      if(httpStackLoadDataEnd()) {
+        
+        if(httpStackAction(HTTP_STACK_ACTION_POST, HTTP_RESP_TIMOUT_IN_MS) == 200) requestSuccess = true;
+        
+      }
+      
+    }
+    
+  }
+  
+  httpStackEnd();
+  
+  return requestSuccess;
+  
+}
+
+
+
+long GPRSbee::getHttpStackMaxDataLength() {
+  
+  // max length of the data which can be input in the AT+HTTPDATA window at the current baud rate (10 bits per char), 
+  // HTTP_STACK_DATA_INPUT_WINDOW_USAGE_PERCENT of the window being used : longer bodies must be posted with several requests
+  
+  long maxDataLength = (_baudRate / 10) * (HTTP_STACK_DATA_INPUT_WINDOW_IN_MS / 1000) * HTTP_STACK_DATA_INPUT_WINDOW_USAGE_PERCENT / 100;
+  
+  return min(maxDataLength, HTTP_STACK_MAX_DATA_LENGTH);
+  
+}
+
+
+
+long GPRSbee::getHttpPostFileBodyLength(long fileContentLength, char *formFieldName) {
+  
+  // exact length of the body written by echoHttpPostFileBodyPart1(), the file content and echoHttpPostFileRequestAdditionalHeadersPart2()
+  
+  long formFieldNameLength = 0;
+  while(formFieldName[formFieldNameLength] != '\0') formFieldNameLength++;
+  
+  char boundary[] = HTTP_POST_FILE_BOUNDARY; 
+  long boundaryLength = 0;
+  while(boundary[boundaryLength] != '\0') boundaryLength++;
+  
+  return (96 + formFieldNameLength + 2 * boundaryLength + fileContentLength);
+  
+}
+
+
+
+void GPRSbee::echoHttpPostFileBodyPart1(char *formFieldName) {
+  
+  serialConnection.print(F("--")); 
+  serialConnection.print(HTTP_POST_FILE_BOUNDARY);   
+  serialConnection.print(F("\r\nContent-Disposition: form-data; name=\""));
+  serialConnection.print(formFieldName);
+  serialConnection.print(F("\"; filename=\"none\"\r\n"));
+  serialConnection.print(F("Content-Type: text/plain\r\n\r\n"));
+  
+}
+
+
+
 void GPRSbee::retrieveIncomingCharsFromLineToLine(char *incomingCharsBuffer, byte incomingCharsBufferLength, byte fromLine, byte toLine, long timeOutInMS) {
 
   // note : the fromLine and toLine indexed lines are included !!!
@@ -553,13 +1648,14 @@ void GPRSbee::retrieveIncomingCharsFromLineToLine(char *incomingCharsBuffer, byt
   
   long clockTimeOut = millis() + timeOutInMS;
   
-  while((millis() < clockTimeOut) && (serialConnection.available() <= 0)) delay(100);
+  // the RX buffer is polled without any pause, as in retrieveATResponse() : at 38400 bauds, the 64 bytes of the SoftwareSerial 
+  // buffer are filled in about 17 ms
     
   while((millis() < clockTimeOut) && (numOfCharsReceived < (incomingCharsBufferLength - 1)) && (numOfLines <= toLine)) {         
       
     if(serialConnection.available() > 0) {
          
-      char c = serialConnection.read(); 
+      char c = readIncomingChar(); 
          
       if(numOfLines  >= fromLine) {
          
@@ -572,15 +1668,13 @@ void GPRSbee::retrieveIncomingCharsFromLineToLine(char *incomingCharsBuffer, byt
          
     }
     
-    else delay(100);
-    
   }
   
   incomingCharsBuffer[numOfCharsReceived] = '\0';
   
   delay(500);
   
-  serialConnection.flush();
+  flushRxBuffer();
   
 }
 
@@ -594,6 +1688,56 @@ void GPRSbee::retrieveHttpResponseStatusLine(char *httpResponseStatusLineBuffer,
 
 
 
+char GPRSbee::waitForHttpResponse(byte linkMask, long timeOutInMS) {
+  
+  // multi-connection mode : waits for a response on one of the links of linkMask, and returns its link number (the lowest one if 
+  // several responses have already been received, -1 if no response has been received before the timeout)
+  // the responses received while sending on another link have been recorded by the links events reader
+  
+  char responseLinkNum = -1;
+  
+  unsigned long clockTimeOut = millis() + timeOutInMS;
+  
+  while(responseLinkNum < 0) {
+    
+    for(byte linkNum = 0 ; (linkNum < TCP_MAX_NUM_OF_LINKS) && (responseLinkNum < 0) ; linkNum++) {
+      
+      if(linkMask & _respondedLinkMask & (1 << linkNum)) responseLinkNum = linkNum;
+      
+    }
+    
+    if(millis() >= clockTimeOut) break;
+    
+    if(serialConnection.available() > 0) readIncomingChar();
+    
+  }
+  
+  if(DEBUG_MODE and _debugSerialConnectionEnabled and (responseLinkNum >= 0)) {
+  
+    _debugSerialConnection->print((int) responseLinkNum);
+    _debugSerialConnection->print(" : ");
+    _debugSerialConnection->println(_httpResponseStatusCodes[responseLinkNum]);
+  
+  }
+  
+  return responseLinkNum;
+  
+}
+
+
+
+int GPRSbee::getHttpResponseStatusCode(byte linkNum) {
+  
+  // 0 if no response has been received on this link since its tcpConnectStart() call
+  
+  if((linkNum >= TCP_MAX_NUM_OF_LINKS) || !(_respondedLinkMask & (1 << linkNum))) return 0;
+  
+  return _httpResponseStatusCodes[linkNum];
+  
+}
+
+
+
 void GPRSbee::retrieveHttpResponseBodyFromLineToLine(char *httpResponseBodyBuffer, byte httpResponseBodyBufferLength, 
                                                      byte fromLine, byte toLine, long timeOutInMS) {
 
@@ -609,13 +1753,13 @@ void GPRSbee::retrieveHttpResponseBodyFromLineToLine(char *httpResponseBodyBuffe
   
   long clockTimeOut = responseHeadersRetrieveStartMillis + timeOutInMS;
   
-  while((millis() < clockTimeOut) && (serialConnection.available() <= 0)) delay(100);
+  // polled without any pause (see retrieveIncomingCharsFromLineToLine())
   
   while((millis() < clockTimeOut) && !responseBodyAvailable) {  
   
     if(serialConnection.available() > 0) {
          
-      char c = serialConnection.read(); 
+      char c = readIncomingChar(); 
          
       if(c=='\n') {
       
@@ -628,8 +1772,6 @@ void GPRSbee::retrieveHttpResponseBodyFromLineToLine(char *httpResponseBodyBuffe
          
     }
     
-    else delay(100);
-    
   }
   
   long responseBodyRetrieveStartMillis = millis();
@@ -646,6 +1788,7 @@ void GPRSbee::retrieveHttpResponseBodyFromLineToLine(char *httpResponseBodyBuffe
 
 void GPRSbee::requestAT(char *command, byte respMaxNumOflines, long timeOutInMS) {
   
+  TRACE_SPAN(TRACE_EVENT_REQUEST_AT);
   
   if(DEBUG_MODE and _debugSerialConnectionEnabled) {
   
@@ -656,21 +1799,60 @@ void GPRSbee::requestAT(char *command, byte respMaxNumOflines, long timeOutInMS)
   
   delay(150);
   
-  serialConnection.flush();
+  flushRxBuffer();
+  
+  serialConnection.print(command); 
+  serialConnection.print("\r\n");  
+  
+  retrieveATResponse(respMaxNumOflines, timeOutInMS);
+  
+}
+
+
+
+void GPRSbee::requestAT(const __FlashStringHelper *commandF, char *parameter, const __FlashStringHelper *commandEndF, byte respMaxNumOflines, long timeOutInMS) {
+  
+  // the command is sent in 3 parts (example : F("AT+SAPBR=3,1,\"APN\",\""), networkAPN, F("\"")), so that no RAM buffer is required 
+  // to build it
+  
+  TRACE_SPAN(TRACE_EVENT_REQUEST_AT);
+  
+  if(DEBUG_MODE and _debugSerialConnectionEnabled) {
+  
+    _debugSerialConnection->print("-> ");
+    _debugSerialConnection->print(commandF);
+    _debugSerialConnection->print(parameter);
+    _debugSerialConnection->println(commandEndF);
+  
+  }
+  
+  delay(150);
+  
+  flushRxBuffer();
+  
+  serialConnection.print(commandF); 
+  serialConnection.print(parameter); 
+  serialConnection.print(commandEndF); 
+  serialConnection.print("\r\n");  
+  
+  retrieveATResponse(respMaxNumOflines, timeOutInMS);
+  
+}
+
+
+
+void GPRSbee::retrieveATResponse(byte respMaxNumOflines, long timeOutInMS) {
 
   byte numOfCharsReceived = 0;
   byte numOfLines = 0;
     
   long clockTimeOut = millis() + timeOutInMS;
   
-  serialConnection.print(command); 
-  serialConnection.print("\r\n");  
-  
   while ((millis() < clockTimeOut) && (numOfCharsReceived < (AT_RX_BUFFER_SIZE - 1)) && (numOfLines < respMaxNumOflines)) {  
     
     if(serialConnection.available() > 0) {
        
-      char c = serialConnection.read();
+      char c = readIncomingChar();
 
       _atRxBuffer[numOfCharsReceived] = c;
       numOfCharsReceived++;
@@ -685,7 +1867,7 @@ void GPRSbee::requestAT(char *command, byte respMaxNumOflines, long timeOutInMS)
   
   delay(150);
 
-  serialConnection.flush();
+  flushRxBuffer();
   
   
   if(DEBUG_MODE and _debugSerialConnectionEnabled) {
@@ -1,7 +1,7 @@
 /*
  * File : GPRSbee.h
  *
- * Version : 0.8.1
+ * Version : 0.8.13
  *
  * Purpose : GPRSBEE modem (http://www.gprsbee.com) interface library for Arduino
  *
@@ -16,6 +16,20 @@
  * History :
  * 
  * - 0.8.1 : bug fix in the requestAT() method
+ * - 0.8.2 : DNS resolution cache (AT+CDNSGIP), stored in RAM and EEPROM, for the tcpConnect() method
+ * - 0.8.3 : alternative HTTP transport based on the modem's built-in HTTP stack (AT+HTTPINIT / HTTPDATA / HTTPACTION / HTTPREAD)
+ * - 0.8.4 : serial link baud rate negotiation (AT+IPR) persisted in EEPROM, HardwareSerial backend
+ * - 0.8.5 : multi-connection mode (AT+CIPMUX=1) : concurrent TCP connections, per link transmissions and responses
+ * - 0.8.6 : cumulative power on time (powerOnTimeInMS), measured by togglePowerState()
+ * - 0.8.7 : spans tracing (see SpanTrace.h) : requestAT(), tcpConnect()
+ * - 0.8.8 : the SoftwareSerial connection to the modem is supplied by the caller (as the HardwareSerial one)
+ * - 0.8.9 : multi-connection mode : the links events ("<link>, CONNECT OK", "+RECEIVE,<link>" + status line) are parsed by a single 
+ *           reader fed with every received char while links are tracked, instead of being flushed with the AT responses
+ * - 0.8.10 : powerOnTimeInMS : a modem found on (at boot...) and powered off without a power on seen by togglePowerState() is not counted
+ * - 0.8.11 : retrieveIncomingCharsFromLineToLine() / retrieveHttpResponseBodyFromLineToLine() : RX buffer polled without the 100 ms pauses
+ *            (responses longer than the 64 bytes SoftwareSerial buffer were truncated at the negotiated baud rates)
+ * - 0.8.12 : TCP transport : the Content-Length of the posted file is computed by getHttpPostFileBodyLength() (was 1 byte short)
+ * - 0.8.13 : getHttpStackMaxDataLength() : max body length which can be input in the AT+HTTPDATA window at the current baud rate
  * 
  */
  
@@ -35,6 +49,11 @@
 #define AT_RX_BUFFER_SIZE 61
 
 
+#define SERIAL_CONNECTION_DEFAULT_BAUD_RATE 9600              // the modem's autobaud mode is reliable at this rate
+
+#define SERIAL_CONNECTION_BAUD_RATE_MARKER 0x5A
+
+
 # define DEBUG_MODE true
 
 
@@ -58,14 +77,66 @@
 
 #define AT_CIPSHUT_RESP_TIMOUT_IN_MS 5000
 
+#define AT_CDNSGIP_RESP_TIMOUT_IN_MS 15000
+
+#define AT_SAPBR_RESP_TIMOUT_IN_MS 30000
+
+#define AT_HTTPDATA_RESP_TIMOUT_IN_MS 5000
+
+#define AT_HTTPREAD_RESP_TIMOUT_IN_MS 5000
+
+#define AT_IPR_RESP_TIMOUT_IN_MS 2000
+
 #define HTTP_RESP_TIMOUT_IN_MS 60000
 
 
+#define HTTP_STACK_DATA_INPUT_WINDOW_IN_MS 120000L             // AT+HTTPDATA input time (SIM900 max)
+
+#define HTTP_STACK_DATA_INPUT_WINDOW_USAGE_PERCENT 50          // margin for the time spent by the caller to produce the data (EEPROM reads...)
+
+#define HTTP_STACK_MAX_DATA_LENGTH 318976L                     // AT+HTTPDATA max size (SIM900)
+
+
+#define TCP_MAX_NUM_OF_LINKS 6                                 // multi-connection mode : links 0 to 5
+
+#define TCP_LINK_EVENT_LINE_BUFFER_SIZE 24
+
+
 #define HTTP_POST_FILE_DEFAULT_FORM_FIELD_NAME "f"
 
 #define HTTP_POST_FILE_BOUNDARY "BOUNDARY"
 
 
+#define HTTP_STACK_ACTION_GET 0
+
+#define HTTP_STACK_ACTION_POST 1
+
+
+#define DNS_CACHE_MARKER 0xA5
+
+#define DNS_CACHE_IP_ADDRESS_BUFFER_SIZE 16
+
+
+
+struct BaudRateEntry {
+  
+  byte marker;                                              // SERIAL_CONNECTION_BAUD_RATE_MARKER if the entry has been written at least once
+  long baudRate;                                            // rate stored in the modem's profile (AT&W), 0 if the modem is in autobaud mode
+  
+};
+
+
+
+struct DNSCacheEntry {
+  
+  byte marker;                                              // DNS_CACHE_MARKER if the entry has been written at least once
+  unsigned int hostNameHash;                                // hash of the resolved host name (see getHostNameHash())
+  char ipAddress[DNS_CACHE_IP_ADDRESS_BUFFER_SIZE];         // "xxx.xxx.xxx.xxx"
+  unsigned long expirationTimestamp;                        // seconds since 01 Jan 1970 00:00:00 GMT
+  
+};
+
+
 
 
 
@@ -75,14 +146,26 @@ class GPRSbee {
 
   public:
 
-    SoftwareSerial serialConnection;
+    Stream &serialConnection;                         // the SoftwareSerial or HardwareSerial connection supplied to the constructor
+    
+    unsigned long powerOnTimeInMS;                    // cumulative time spent powered on (including the power on / off sequences), millis() based
     
-    GPRSbee(byte onOffPin, byte statusPin, byte rxPin, byte txPin);
+    GPRSbee(byte onOffPin, byte statusPin, SoftwareSerial *softwareSerialConnection);
     
-    GPRSbee(byte onOffPin, byte statusPin, byte rxPin, byte txPin, SoftwareSerial *debugSerialConnection);
+    GPRSbee(byte onOffPin, byte statusPin, SoftwareSerial *softwareSerialConnection, SoftwareSerial *debugSerialConnection);
+    
+    GPRSbee(byte onOffPin, byte statusPin, HardwareSerial *hardwareSerialConnection);
+    
+    GPRSbee(byte onOffPin, byte statusPin, HardwareSerial *hardwareSerialConnection, SoftwareSerial *debugSerialConnection);
     
     void init(long baudRate);
     
+    void enableBaudRateNegotiation(long maxBaudRate, int eepromAddress);
+    
+    long negotiateBaudRate();
+    
+    long getBaudRate();
+    
     void powerOn();
    
     void powerOff();
@@ -93,6 +176,8 @@ class GPRSbee {
     
     void requestAT(char *command, byte respMaxNumOflines, long timeOutInMS);
     
+    void requestAT(const __FlashStringHelper *commandF, char *parameter, const __FlashStringHelper *commandEndF, byte respMaxNumOflines, long timeOutInMS);
+    
     void requestAT(const __FlashStringHelper *commandF, byte respMaxNumOflines, long timeOutInMS);
     
     boolean isAtRXBufferEmpty();
@@ -121,8 +206,26 @@ class GPRSbee {
     
     boolean isConnectedToNet();
     
+    void enableDNSCache(int eepromAddress, unsigned long ttlInS);
+    
+    boolean resolveHostName(char *hostName, char *ipAddressBuffer);
+    
     boolean tcpConnect(char *serverName, char *serverPort, byte maxNumConnectAttempts);
     
+    boolean tcpConnect(char *serverName, char *serverPort, byte maxNumConnectAttempts, unsigned long timestampNow);
+    
+    void enableMultiConnectionMode();
+    
+    boolean isMultiConnectionModeEnabled();
+    
+    void selectTcpLink(byte linkNum);
+    
+    void tcpConnectStart(byte linkNum, char *serverName, char *serverPort);
+    
+    byte waitForTcpConnect(byte linkMask, boolean waitForAllLinks, long timeOutInMS);
+    
+    void tcpSendBegin();
+    
     void tcpSendChars(char *chars);
     
     void tcpClose();
@@ -141,10 +244,40 @@ class GPRSbee {
     
     boolean httpPostTextFile(char *serverName, char *serverPort, char *serverURL, char *fileContent, byte maxNumConnectAttempts);
     
+    void connectBearer(char *networkAPN, char *username, char *password);
+    
+    void disconnectBearer();
+    
+    boolean isBearerConnected();
+    
+    boolean httpStackBegin(char *serverName, char *serverPort, char *serverURL, char *contentType);
+    
+    boolean httpStackLoadDataBegin(long dataLength);
+    
+    boolean httpStackLoadDataEnd();
+    
+    int httpStackAction(byte action, long timeOutInMS);
+    
+    void httpStackReadResponseBody(char *httpResponseBodyBuffer, byte httpResponseBodyBufferLength);
+    
+    void httpStackEnd();
+    
+    boolean httpStackPostTextFile(char *serverName, char *serverPort, char *serverURL, char *fileContent);
+    
+    long getHttpStackMaxDataLength();
+    
+    long getHttpPostFileBodyLength(long fileContentLength, char *formFieldName);
+    
+    void echoHttpPostFileBodyPart1(char *formFieldName);
+    
     void retrieveIncomingCharsFromLineToLine(char *incomingCharsBuffer, byte incomingCharsBufferLength, byte fromLine, byte toLine, long timeOutInMS);
     
     void retrieveHttpResponseStatusLine(char *httpResponseStatusLineBuffer, byte httpResponseStatusLineBufferLength, long timeOutInMS);
     
+    char waitForHttpResponse(byte linkMask, long timeOutInMS);
+    
+    int getHttpResponseStatusCode(byte linkNum);
+    
     void retrieveHttpResponseBodyFromLineToLine(char *httpResponseBodyBuffer, byte httpResponseBodyBufferLength, byte fromLine, byte toLine, long timeOutInMS);
 
   private:
@@ -155,11 +288,77 @@ class GPRSbee {
     
     byte _statusPin;
     
+    SoftwareSerial *_softwareSerialConnection;
+    
+    HardwareSerial *_hardwareSerialConnection;
+    
+    long _baudRate;
+    
+    long _maxBaudRate;
+    
+    int _baudRateEEPROMAddress;
+    
+    boolean _baudRateNegotiationEnabled;
+    
+    boolean _multiConnectionModeEnabled;
+    
+    byte _tcpLinkNum;
+    
+    byte _trackedLinkMask;                            // links whose events are parsed (from tcpConnectStart() to tcpClose())
+    
+    byte _connectResultLinkMask;                      // links for which a "<link>, CONNECT ..." result has been received
+    
+    byte _connectedLinkMask;
+    
+    byte _respondedLinkMask;                          // links for which the status line of a HTTP response has been received
+    
+    int _httpResponseStatusCodes[TCP_MAX_NUM_OF_LINKS];
+    
+    char _receivingLinkNum;                           // link of the last "+RECEIVE,<link>,<length>:" line (-1 : none)
+    
+    char _linkEventLineBuffer[TCP_LINK_EVENT_LINE_BUFFER_SIZE];
+    
+    byte _linkEventLineLength;
+    
     SoftwareSerial *_debugSerialConnection;
     
     boolean _debugSerialConnectionEnabled;
     
+    DNSCacheEntry _dnsCache;
+    
+    boolean _dnsCacheEnabled;
+    
+    int _dnsCacheEEPROMAddress;
+    
+    unsigned long _dnsCacheTTLInS;
+    
+    unsigned long _powerOnMS;
+    
     void togglePowerState();
+    
+    void retrieveATResponse(byte respMaxNumOflines, long timeOutInMS);
+    
+    void flushRxBuffer();
+    
+    void beginSerialConnection(long baudRate);
+    
+    boolean isCommunicationReliable();
+    
+    boolean requestBaudRate(long baudRate);
+    
+    void saveBaudRate(long baudRate);
+    
+    void buildTcpConnectRequest(char *connectRequestBuffer, byte linkNum, char *serverName, char *serverPort);
+    
+    char readIncomingChar();
+    
+    void processLinkEventChar(char c);
+    
+    void processLinkEventLine();
+    
+    unsigned int getHostNameHash(char *hostName);
+    
+    void saveDNSCache();
 
 };
 
@@ -1,7 +1,7 @@
 /*
  * File : MStore_24LC1025.cpp
  *
- * Version : 0.8.0
+ * Version : 0.8.4
  *
  * Purpose : 24LC1025 EEPROM "store" interface library for Arduino
  *
@@ -13,6 +13,14 @@
  *
  * Creation date : 2014/01/29
  *
+ * History :
+ *
+ * - 0.8.1 : priority messages (flag stored in the bit 7 of the message length byte), priority messages selection
+ * - 0.8.2 : cumulative I2C busy time (busyTimeInMS) of the store, retrieve, count and clear operations
+ * - 0.8.3 : spans tracing (see SpanTrace.h) : storeMessage(), retrieveMessage(), clearPage()
+ * - 0.8.4 : messages count, priority messages count and messages bytes count cached in RAM (computed by init(), then updated on
+ *           each write / clear) : getMessagesCount() does not scan the pages anymore, getMessagesBytesCount()
+ *
  */
  
  
@@ -24,12 +32,24 @@
 
 #include "MStore_24LC1025.h"
 
+#include "SpanTrace.h"
+
 
 
 
 MStore_24LC1025::MStore_24LC1025(byte storeAddress) {
 
   _storeAddress = storeAddress;
+  
+  busyTimeInMS = 0;
+  
+  _countsCached = false;
+  
+  _messagesCount = 0;
+  
+  _priorityMessagesCount = 0;
+  
+  _messagesBytesCount = 0;
 
 }
 
@@ -37,6 +57,14 @@ MStore_24LC1025::MStore_24LC1025(byte storeAddress) {
 
 void MStore_24LC1025::init() {
 
+  _countsCached = false;
+  
+  _messagesCount = 0;
+  
+  _priorityMessagesCount = 0;
+  
+  _messagesBytesCount = 0;
+
   for(int pageIndex = 0 ; pageIndex < 1024 ; pageIndex++) {
   
     unsigned long writesCount = getWritesCount(pageIndex);
@@ -44,7 +72,11 @@ void MStore_24LC1025::init() {
     if(writesCount == 0xFFFFFF) smashPage(pageIndex);     // here we have a page which has never been written before
                                                           //  (if of course we use a new chip !)
     
+    else updateCounts(readMessageLengthByte(pageIndex), true);
+    
   }
+  
+  _countsCached = true;
 
 }
 
@@ -98,7 +130,9 @@ unsigned long MStore_24LC1025::getWritesCount(int pageIndex) {
 
 
     
-byte MStore_24LC1025::getMessageLength(int pageIndex) {
+byte MStore_24LC1025::readMessageLengthByte(int pageIndex) {
+
+  // the 4th byte of the page : message length and priority flag
 
   byte twiAddress = getTwiAddress(pageIndex);
   unsigned int pageStartAddress = getPageStartAddress(pageIndex);
@@ -110,15 +144,57 @@ byte MStore_24LC1025::getMessageLength(int pageIndex) {
  
   Wire.requestFrom((int) twiAddress, 1);
   
-  byte messageLength = Wire.read();
+  return Wire.read();
   
-  return messageLength;
+}
+
+
+
+void MStore_24LC1025::updateCounts(byte messageLengthByte, boolean messageAdded) {
+
+  byte messageLength = messageLengthByte & ~MSTORE_PRIORITY_FLAG;
+  
+  if(messageLength == 0) return;
+  
+  if(messageAdded) {
+  
+    _messagesCount++;
+    
+    if(messageLengthByte & MSTORE_PRIORITY_FLAG) _priorityMessagesCount++;
+    
+    _messagesBytesCount += messageLength;
+  
+  }
+  
+  else {
+  
+    _messagesCount--;
+    
+    if(messageLengthByte & MSTORE_PRIORITY_FLAG) _priorityMessagesCount--;
+    
+    _messagesBytesCount -= messageLength;
+  
+  }
   
 }
 
 
+    
+byte MStore_24LC1025::getMessageLength(int pageIndex, boolean priorityMessagesOnly) {
+
+  // priorityMessagesOnly : 0 is returned for the messages stored without the priority flag
+
+  byte messageLength = readMessageLengthByte(pageIndex);
+  
+  if(priorityMessagesOnly and !(messageLength & MSTORE_PRIORITY_FLAG)) return 0;
   
-boolean MStore_24LC1025::writeMessage(int pageIndex, char* message) {
+  return messageLength & ~MSTORE_PRIORITY_FLAG;
+  
+}
+
+
+  
+boolean MStore_24LC1025::writeMessage(int pageIndex, char* message, boolean priority) {
 
 
   boolean messageWritten = false;
@@ -139,6 +215,8 @@ boolean MStore_24LC1025::writeMessage(int pageIndex, char* message) {
   
     byte twiAddress = getTwiAddress(pageIndex);
     unsigned int pageStartAddress = getPageStartAddress(pageIndex);
+    
+    if(_countsCached) updateCounts(readMessageLengthByte(pageIndex), false);          // the page may hold a message already
   
     // writesCount update (value stored in the 3 first bytes of the page)
   
@@ -164,7 +242,8 @@ boolean MStore_24LC1025::writeMessage(int pageIndex, char* message) {
     Wire.write((int)((pageStartAddress + 3) >> 8));  
     Wire.write((int)((pageStartAddress + 3) & 0xFF)); 
         
-    Wire.write((byte) messageLength);
+    if(priority) Wire.write((byte) (messageLength | MSTORE_PRIORITY_FLAG));
+    else Wire.write((byte) messageLength);
          
     Wire.endTransmission();
     delay(10); 
@@ -198,6 +277,13 @@ boolean MStore_24LC1025::writeMessage(int pageIndex, char* message) {
     
     
     messageWritten = true;
+    
+    if(_countsCached) {
+    
+      if(priority) updateCounts(messageLength | MSTORE_PRIORITY_FLAG, true);
+      else updateCounts(messageLength, true);
+      
+    }
   
   }
   
@@ -207,7 +293,11 @@ boolean MStore_24LC1025::writeMessage(int pageIndex, char* message) {
     
     
     
-boolean MStore_24LC1025::storeMessage(char* message) {
+boolean MStore_24LC1025::storeMessage(char* message, boolean priority) {
+
+  TRACE_SPAN(TRACE_EVENT_STORE_MESSAGE);
+
+  unsigned long startMS = millis();
 
   boolean success = false;
   
@@ -222,7 +312,9 @@ boolean MStore_24LC1025::storeMessage(char* message) {
   
   }
   
-  if(pageIndexFound) success = writeMessage(pageIndex, message);
+  if(pageIndexFound) success = writeMessage(pageIndex, message, priority);
+  
+  busyTimeInMS += millis() - startMS;
   
   return success;
   
@@ -230,24 +322,51 @@ boolean MStore_24LC1025::storeMessage(char* message) {
 
 
 
-int MStore_24LC1025::getMessagesCount() {
+int MStore_24LC1025::getMessagesCount(boolean priorityMessagesOnly) {
+
+  // the pages are scanned only if init() has not been called
+
+  if(_countsCached) {
+  
+    if(priorityMessagesOnly) return _priorityMessagesCount;
+    else return _messagesCount;
+    
+  }
+
+  unsigned long startMS = millis();
 
   int messagesCount = 0;
   
   for(int pageIndex = 0 ; pageIndex < 1024 ; pageIndex++) {
   
-    if(getMessageLength(pageIndex)) messagesCount++;
+    if(getMessageLength(pageIndex, priorityMessagesOnly)) messagesCount++;
   
   }
+  
+  busyTimeInMS += millis() - startMS;
 
   return messagesCount;
   
 }
 
 
+
+unsigned long MStore_24LC1025::getMessagesBytesCount() {
+
+  // sum of the stored messages lengths (0 if init() has not been called)
+
+  return _messagesBytesCount;
+  
+}
+
+
     
 void MStore_24LC1025::retrieveMessage(int pageIndex, char* message) {
 
+  TRACE_SPAN(TRACE_EVENT_RETRIEVE_MESSAGE);
+
+  unsigned long startMS = millis();
+
   byte twiAddress = getTwiAddress(pageIndex);
   unsigned int pageStartAddress = getPageStartAddress(pageIndex);
   
@@ -284,6 +403,8 @@ void MStore_24LC1025::retrieveMessage(int pageIndex, char* message) {
   }
   
   message[numCharsReaden++] = '\0';
+  
+  busyTimeInMS += millis() - startMS;
 
 }
 
@@ -291,9 +412,13 @@ void MStore_24LC1025::retrieveMessage(int pageIndex, char* message) {
     
 void MStore_24LC1025::clearPage(int pageIndex) {
 
-  byte messageLength = getMessageLength(pageIndex);
+  TRACE_SPAN(TRACE_EVENT_CLEAR_PAGE);
+
+  unsigned long startMS = millis();
+
+  byte messageLengthByte = readMessageLengthByte(pageIndex);
   
-  if(messageLength) {
+  if(messageLengthByte & ~MSTORE_PRIORITY_FLAG) {
   
     byte twiAddress = getTwiAddress(pageIndex);
     unsigned int pageStartAddress = getPageStartAddress(pageIndex);
@@ -318,8 +443,12 @@ void MStore_24LC1025::clearPage(int pageIndex) {
       }
         
     }
+    
+    if(_countsCached) updateCounts(messageLengthByte, false);
   
   }
+  
+  busyTimeInMS += millis() - startMS;
 
 }
 
@@ -341,6 +470,8 @@ void MStore_24LC1025::smashPage(int pageIndex) {
   byte twiAddress = getTwiAddress(pageIndex);
   unsigned int pageStartAddress = getPageStartAddress(pageIndex);
   
+  if(_countsCached) updateCounts(readMessageLengthByte(pageIndex), false);
+  
   for(byte i = 0 ; i < 128 ; i ++) {
     
     if((i % MAX_CHUNK_SIZE) == 0) {                                           // start of chunk
@@ -1,7 +1,7 @@
 /*
  * File : MStore_24LC1025.h
  *
- * Version : 0.8.0
+ * Version : 0.8.4
  *
  * Purpose : 24LC1025 EEPROM "store" interface library for Arduino
  *
@@ -12,6 +12,14 @@
  * License: GNU GPL v2 (see License.txt)
  *
  * Creation date : 2014/01/29
+ *
+ * History :
+ *
+ * - 0.8.1 : priority messages (flag stored in the bit 7 of the message length byte), priority messages selection
+ * - 0.8.2 : cumulative I2C busy time (busyTimeInMS) of the store, retrieve, count and clear operations
+ * - 0.8.3 : spans tracing (see SpanTrace.h) : storeMessage(), retrieveMessage(), clearPage()
+ * - 0.8.4 : messages count, priority messages count and messages bytes count cached in RAM (computed by init(), then updated on
+ *           each write / clear) : getMessagesCount() does not scan the pages anymore, getMessagesBytesCount()
  * 
  */
 
@@ -34,6 +42,8 @@
 
 #define MAX_NUM_WRITES_PER_PAGE 100000
 
+#define MSTORE_PRIORITY_FLAG 0x80                      // bit 7 of the message length byte (the messages are 124 chars max)
+
 
 
 
@@ -42,19 +52,23 @@ class MStore_24LC1025 {
 
   public:
   
+    unsigned long busyTimeInMS;                         // cumulative duration of the storeMessage(), getMessagesCount(), retrieveMessage() and clearPage() calls
+  
     MStore_24LC1025(byte storeAddress);
     
     void init();
     
-    boolean writeMessage(int pageIndex, char* message);
+    boolean writeMessage(int pageIndex, char* message, boolean priority = false);
 
-    boolean storeMessage(char* message);
+    boolean storeMessage(char* message, boolean priority = false);
+    
+    int getMessagesCount(boolean priorityMessagesOnly = false);
     
-    int getMessagesCount();
+    unsigned long getMessagesBytesCount();
     
     unsigned long getWritesCount(int pageIndex);
     
-    byte getMessageLength(int pageIndex);
+    byte getMessageLength(int pageIndex, boolean priorityMessagesOnly = false);
     
     void retrieveMessage(int pageIndex, char* message);
 
@@ -74,7 +88,19 @@ class MStore_24LC1025 {
   private:
   
     byte _storeAddress;
+    
+    boolean _countsCached;                              // true once init() has scanned the pages
+    
+    int _messagesCount;
+    
+    int _priorityMessagesCount;
+    
+    unsigned long _messagesBytesCount;
   
+    byte readMessageLengthByte(int pageIndex);
+    
+    void updateCounts(byte messageLengthByte, boolean messageAdded);
+    
     byte getTwiAddress(int pageIndex);
     
     unsigned int getPageStartAddress(int pageIndex);
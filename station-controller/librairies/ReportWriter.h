@@ -0,0 +1,312 @@
+/*
+ * File : ReportWriter.h
+ *
+ * Version : 0.8.1
+ *
+ * Purpose : bounded, allocation-free reports serializer for Arduino, with compile-time selected output formats (pipe separated, CSV, JSON)
+ *
+ * Author : Previmeteo (www.previmeteo.com)
+ *
+ * Project web site : http://oses.previmeteo.com/
+ *
+ * License: GNU GPL v2 (see License.txt)
+ *
+ * Creation date : 2026/10/19
+ *
+ * History :
+ *
+ * - 0.8.1 : addRecordType() : records other than the sensors reports ("health", "trace"...) can be told apart in the positional formats
+ *
+ * Notes :
+ *
+ * - header only : ReportWriter is a template, so only the format actually used by the sketch is compiled
+ * - the values are formatted with integer arithmetic only (no dtostrf())
+ *
+ */
+
+
+
+
+#ifndef REPORT_WRITER_h
+#define REPORT_WRITER_h
+
+
+
+#include "Arduino.h"
+
+
+
+
+#define REPORT_RECORD_TYPE_PREFIX '@'                    // first char of the records other than the sensors reports, in the positional formats
+
+
+
+
+// output formats : the field name is only written if namesWritten() is true, the string values are quoted if stringsQuoted() is true
+
+struct PipeReportFormat {
+
+  // "st01|1392912000|12.5|..."
+
+  static const char *reportStart() { return ""; }
+  static const char *fieldSeparator() { return "|"; }
+  static const char *reportEnd() { return ""; }
+  static const char *emptyValue() { return ""; }
+  static boolean namesWritten() { return false; }
+  static boolean stringsQuoted() { return false; }
+
+};
+
+
+
+struct CSVReportFormat {
+
+  // "st01,1392912000,12.5,..."
+
+  static const char *reportStart() { return ""; }
+  static const char *fieldSeparator() { return ","; }
+  static const char *reportEnd() { return ""; }
+  static const char *emptyValue() { return ""; }
+  static boolean namesWritten() { return false; }
+  static boolean stringsQuoted() { return false; }
+
+};
+
+
+
+struct JSONReportFormat {
+
+  // "{"id":"st01","ts":1392912000,"t":12.5,...}"
+
+  static const char *reportStart() { return "{"; }
+  static const char *fieldSeparator() { return ","; }
+  static const char *reportEnd() { return "}"; }
+  static const char *emptyValue() { return "null"; }
+  static boolean namesWritten() { return true; }
+  static boolean stringsQuoted() { return true; }
+
+};
+
+
+
+
+template <class Format> class ReportWriter {
+
+
+  public:
+
+    ReportWriter(char *buffer, byte bufferLength) {
+
+      _buffer = buffer;
+      _bufferLength = bufferLength;
+
+      _length = 0;
+      _numOfFields = 0;
+      _overflow = false;
+
+      _buffer[0] = '\0';
+
+      appendChars(Format::reportStart());
+
+    }
+
+
+    void addRecordType(const char *recordType) {
+
+      // records other than the sensors reports (first field) : "rec" field in the formats with names ("rec":"health"), 
+      // REPORT_RECORD_TYPE_PREFIX + type in the positional ones ("@health|st01|..."), which a sensors report (starting with 
+      // the station id) never starts with
+
+      beginField("rec");
+
+      if(Format::stringsQuoted()) appendChar('"');
+      if(!Format::namesWritten()) appendChar(REPORT_RECORD_TYPE_PREFIX);
+      appendChars(recordType);
+      if(Format::stringsQuoted()) appendChar('"');
+
+    }
+
+
+    void addString(const char *fieldName, const char *value) {
+
+      beginField(fieldName);
+
+      if(Format::stringsQuoted()) appendChar('"');
+      appendChars(value);
+      if(Format::stringsQuoted()) appendChar('"');
+
+    }
+
+
+    void addUnsigned(const char *fieldName, unsigned long value) {
+
+      beginField(fieldName);
+
+      appendUnsigned(value, 1);
+
+    }
+
+
+    void addFixedPoint(const char *fieldName, long value, byte valueNumOfDecimals, byte numOfDecimals) {
+
+      // addFixedPoint(name, -1234567, 6, 4) -> "-1.2346" : value rounded to numOfDecimals (<= valueNumOfDecimals)
+
+      beginField(fieldName);
+
+      unsigned long divider = 1;
+
+      for(byte i = numOfDecimals ; i < valueNumOfDecimals ; i++) divider *= 10;
+
+      boolean negative = (value < 0);
+
+      unsigned long absoluteValue = negative ? -value : value;
+
+      absoluteValue = (absoluteValue + divider / 2) / divider;
+
+      if(negative and (absoluteValue > 0)) appendChar('-');            // no "-0.0000"
+
+      unsigned long decimalsDivider = 1;
+
+      for(byte i = 0 ; i < numOfDecimals ; i++) decimalsDivider *= 10;
+
+      appendUnsigned(absoluteValue / decimalsDivider, 1);
+
+      if(numOfDecimals > 0) {
+
+        appendChar('.');
+        appendUnsigned(absoluteValue % decimalsDivider, numOfDecimals);
+
+      }
+
+    }
+
+
+    void addFloat(const char *fieldName, float value, byte numOfDecimals) {
+
+      // the value is converted once to fixed-point (rounded), then formatted as such
+
+      float scaledValue = value;
+
+      for(byte i = 0 ; i < numOfDecimals ; i++) scaledValue *= 10;
+
+      addFixedPoint(fieldName, (long) (scaledValue + ((scaledValue < 0) ? -0.5 : 0.5)), numOfDecimals, numOfDecimals);
+
+    }
+
+
+    void addEmpty(const char *fieldName) {
+
+      beginField(fieldName);
+
+      appendChars(Format::emptyValue());
+
+    }
+
+
+    boolean end() {
+
+      // returns false if the report has been truncated (buffer too small)
+
+      appendChars(Format::reportEnd());
+
+      return !_overflow;
+
+    }
+
+
+    boolean isOverflowed() {
+
+      return _overflow;
+
+    }
+
+
+    byte getLength() {
+
+      return _length;
+
+    }
+
+
+  private:
+
+    char *_buffer;
+
+    byte _bufferLength;
+
+    byte _length;
+
+    byte _numOfFields;
+
+    boolean _overflow;
+
+
+    void beginField(const char *fieldName) {
+
+      if(_numOfFields > 0) appendChars(Format::fieldSeparator());
+
+      if(Format::namesWritten()) {
+
+        appendChar('"');
+        appendChars(fieldName);
+        appendChar('"');
+        appendChar(':');
+
+      }
+
+      _numOfFields++;
+
+    }
+
+
+    void appendChar(char c) {
+
+      // the buffer is always '\0' terminated : the chars which do not fit are dropped
+
+      if(_length < (_bufferLength - 1)) {
+
+        _buffer[_length] = c;
+        _length++;
+        _buffer[_length] = '\0';
+
+      }
+
+      else _overflow = true;
+
+    }
+
+
+    void appendChars(const char *chars) {
+
+      while(*chars != '\0') appendChar(*chars++);
+
+    }
+
+
+    void appendUnsigned(unsigned long value, byte minNumOfDigits) {
+
+      // the number is left padded with '0' up to minNumOfDigits digits
+
+      char digits[10];
+
+      byte numOfDigits = 0;
+
+      do {
+
+        digits[numOfDigits++] = '0' + (value % 10);
+        value /= 10;
+
+      } while(value > 0);
+
+      for(byte i = numOfDigits ; i < minNumOfDigits ; i++) appendChar('0');
+
+      while(numOfDigits > 0) appendChar(digits[--numOfDigits]);
+
+    }
+
+
+};
+
+
+
+#endif
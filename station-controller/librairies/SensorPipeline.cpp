@@ -0,0 +1,686 @@
+/*
+ * File : SensorPipeline.cpp
+ *
+ * Version : 0.8.4
+ *
+ * Purpose : pipelined sensors acquisition for Arduino : the warm-up and conversion times of the sensors overlap, the MCU sleeps in between
+ *
+ * Author : Previmeteo (www.previmeteo.com)
+ *
+ * Project web site : http://oses.previmeteo.com/
+ *
+ * License: GNU GPL v2 (see License.txt)
+ *
+ * Creation date : 2026/10/19
+ *
+ * History :
+ *
+ * - 0.8.1 : sensors registry : report fields declared by the drivers (name, precision), per sensor sampling period
+ * - 0.8.2 : per field statistics (min / max / mean / count) of the sensors oversampled between two reports (sample())
+ * - 0.8.3 : fields triggers (range limits and max change) definition, fields lookup by name
+ * - 0.8.4 : cumulative run time (runTimeInMS), sleeping time included
+ *
+ */
+
+
+
+
+#include "Arduino.h"
+
+#include "LowPower.h"
+
+#include <avr/sleep.h>
+
+#include "SensorPipeline.h"
+
+
+
+
+EMPTY_INTERRUPT(ADC_vect);              // ADC conversion complete : only used to wake the MCU up from the ADC noise reduction mode
+
+
+
+
+// report fields of the drivers : {name, value decimals, report decimals}
+
+static const SensorField DHT22_FIELDS[] = {{"t", 1, 1}, {"h", 1, 1}};
+
+static const SensorField BMP085_PRESSURE_FIELDS[] = {{"p", 1, 1}};
+
+static const SensorField BMP085_TEMPERATURE_FIELDS[] = {{"dev_t", 1, 1}};
+
+static const SensorField ANALOG_VOLTAGE_FIELDS[] = {{"bat", 2, 2}};
+
+static const SensorField GPS_POSITION_FIELDS[] = {{"fix_ts", 0, 0}, {"lat", 6, 4}, {"lon", 6, 4}, {"alt", 2, 0}};
+
+
+
+
+static long toFixedPoint(float value, byte numOfDecimals) {
+
+  // rounded : toFixedPoint(-12.345, 2) -> -1235
+
+  for(byte i = 0 ; i < numOfDecimals ; i++) value *= 10;
+
+  return (long) (value + ((value < 0) ? -0.5 : 0.5));
+
+}
+
+
+
+
+SensorPipeline::SensorPipeline() {
+
+  _numOfSensors = 0;
+
+  _numOfStatistics = 0;
+
+  runTimeInMS = 0;
+
+}
+
+
+
+boolean SensorPipeline::addSensor(PipelinedSensor *sensor, unsigned long samplingPeriodInS, boolean statisticsEnabled) {
+
+  // samplingPeriodInS : the sensor is sampled by the first run() of each period (periods aligned on the UTC clock), 0 : by all the runs
+  // statisticsEnabled : the sensor is also sampled by sample(), its values are accumulated until the next resetStatistics()
+
+  if(_numOfSensors >= SENSOR_PIPELINE_MAX_NUM_OF_SENSORS) return false;
+
+  _firstStatisticsIndexes[_numOfSensors] = -1;
+
+  if(statisticsEnabled) {
+
+    if((_numOfStatistics + sensor->getNumOfFields()) > SENSOR_PIPELINE_MAX_NUM_OF_STATISTICS) return false;
+
+    _firstStatisticsIndexes[_numOfSensors] = _numOfStatistics;
+
+    for(byte fieldIndex = 0 ; fieldIndex < sensor->getNumOfFields() ; fieldIndex++) _statistics[_numOfStatistics++].numOfValues = 0;
+
+  }
+
+  _sensors[_numOfSensors] = sensor;
+
+  _samplingPeriodsInS[_numOfSensors] = samplingPeriodInS;
+
+  _lastSamplingTimestamps[_numOfSensors] = 0;
+
+  sensor->resultAvailable = false;
+
+  _numOfSensors++;
+
+  return true;
+
+}
+
+
+
+byte SensorPipeline::getNumOfSensors() {
+
+  return _numOfSensors;
+
+}
+
+
+
+PipelinedSensor *SensorPipeline::getSensor(byte sensorIndex) {
+
+  if(sensorIndex >= _numOfSensors) return NULL;
+
+  return _sensors[sensorIndex];
+
+}
+
+
+
+boolean SensorPipeline::findField(const char *fieldName, byte *sensorIndex, byte *fieldIndex) {
+
+  for(byte i = 0 ; i < _numOfSensors ; i++) {
+
+    for(byte j = 0 ; j < _sensors[i]->getNumOfFields() ; j++) {
+
+      if(strcmp(_sensors[i]->getField(j)->name, fieldName) == 0) {
+
+        *sensorIndex = i;
+        *fieldIndex = j;
+
+        return true;
+
+      }
+
+    }
+
+  }
+
+  return false;
+
+}
+
+
+
+void SensorPipeline::run(unsigned long timestampNow) {
+
+  // all the sensors due are sampled, the sensors which are not due are left with resultAvailable false (empty report fields).
+  // timestampNow = 0 (clock not set) : all the sensors are sampled
+
+  runSensors(timestampNow, false);
+
+}
+
+
+
+void SensorPipeline::sample(unsigned long timestampNow) {
+
+  // intermediate sampling (between two reports) : only the sensors due with statistics enabled are sampled
+
+  runSensors(timestampNow, true);
+
+}
+
+
+
+FieldStatistics *SensorPipeline::getFieldStatistics(byte sensorIndex, byte fieldIndex) {
+
+  // NULL if the statistics of the sensor are disabled
+
+  if((sensorIndex >= _numOfSensors) or (_firstStatisticsIndexes[sensorIndex] < 0)) return NULL;
+
+  return &_statistics[_firstStatisticsIndexes[sensorIndex] + fieldIndex];
+
+}
+
+
+
+void SensorPipeline::resetStatistics() {
+
+  for(byte i = 0 ; i < _numOfStatistics ; i++) _statistics[i].numOfValues = 0;
+
+}
+
+
+
+void SensorPipeline::runSensors(unsigned long timestampNow, boolean statisticsSensorsOnly) {
+
+  // the conversions of the sensors due are started, then the results are collected in the order in which they are ready : the
+  // pipeline lasts about as long as its slowest sensor. The pipeline clock counts the active time (millis()) plus the sleeping time
+  // (millis() is stopped in power down mode)
+
+  unsigned long readyTimes[SENSOR_PIPELINE_MAX_NUM_OF_SENSORS];
+
+  boolean completed[SENSOR_PIPELINE_MAX_NUM_OF_SENSORS];
+
+  unsigned long pipelineClock = 0;
+
+  unsigned long activeStartMS;
+
+  for(byte i = 0 ; i < _numOfSensors ; i++) {
+
+    completed[i] = true;
+
+    if(statisticsSensorsOnly and (_firstStatisticsIndexes[i] < 0)) continue;
+
+    _sensors[i]->resultAvailable = false;
+
+    unsigned long samplingPeriodInS = _samplingPeriodsInS[i];
+
+    boolean due = (timestampNow == 0) or (samplingPeriodInS == 0) or (_lastSamplingTimestamps[i] == 0) 
+                  or ((timestampNow / samplingPeriodInS) != (_lastSamplingTimestamps[i] / samplingPeriodInS));
+
+    completed[i] = !due;
+
+    if(!due) continue;
+
+    _lastSamplingTimestamps[i] = timestampNow;
+
+    activeStartMS = millis();
+
+    readyTimes[i] = pipelineClock + _sensors[i]->startConversion();
+
+    pipelineClock += millis() - activeStartMS;
+
+  }
+
+  while(1) {
+
+    // next sensor to be collected
+
+    char nextSensorIndex = -1;
+
+    for(byte i = 0 ; i < _numOfSensors ; i++) {
+
+      if(!completed[i] and ((nextSensorIndex < 0) or (readyTimes[i] < readyTimes[nextSensorIndex]))) nextSensorIndex = i;
+
+    }
+
+    if(nextSensorIndex < 0) break;
+
+    if(readyTimes[nextSensorIndex] > pipelineClock) {
+
+      sleepMS(readyTimes[nextSensorIndex] - pipelineClock);
+
+      pipelineClock = readyTimes[nextSensorIndex];
+
+    }
+
+    activeStartMS = millis();
+
+    unsigned int nextCollectionDelayInMS = _sensors[nextSensorIndex]->collectResult();
+
+    pipelineClock += millis() - activeStartMS;
+
+    if(nextCollectionDelayInMS == 0) {
+
+      completed[nextSensorIndex] = true;
+
+      updateStatistics(nextSensorIndex);
+
+    }
+
+    else readyTimes[nextSensorIndex] = pipelineClock + nextCollectionDelayInMS;
+
+  }
+
+  runTimeInMS += pipelineClock;
+
+}
+
+
+
+void SensorPipeline::updateStatistics(byte sensorIndex) {
+
+  PipelinedSensor *sensor = _sensors[sensorIndex];
+
+  if((_firstStatisticsIndexes[sensorIndex] < 0) or !sensor->resultAvailable) return;
+
+  for(byte fieldIndex = 0 ; fieldIndex < sensor->getNumOfFields() ; fieldIndex++) {
+
+    FieldStatistics *statistics = &_statistics[_firstStatisticsIndexes[sensorIndex] + fieldIndex];
+
+    if(statistics->numOfValues == 255) continue;                 // saturated : the statistics of the first 255 values are kept
+
+    long value = sensor->getFieldValue(fieldIndex);
+
+    if(statistics->numOfValues == 0) {
+
+      statistics->minValue = value;
+      statistics->maxValue = value;
+      statistics->sumOfValues = 0;
+
+    }
+
+    if(value < statistics->minValue) statistics->minValue = value;
+    if(value > statistics->maxValue) statistics->maxValue = value;
+
+    statistics->sumOfValues += value;
+
+    statistics->numOfValues++;
+
+  }
+
+}
+
+
+
+void SensorPipeline::sleepMS(unsigned long durationInMS) {
+
+  // power down with the watchdog periods as long as possible, then idle (woken up every ms by the timer 0) for the remaining time
+
+  while(durationInMS >= 15) {
+
+    if(durationInMS >= 2000) { LowPower.powerDown(SLEEP_2S, ADC_OFF, BOD_OFF); durationInMS -= 2000; }
+    else if(durationInMS >= 1000) { LowPower.powerDown(SLEEP_1S, ADC_OFF, BOD_OFF); durationInMS -= 1000; }
+    else if(durationInMS >= 500) { LowPower.powerDown(SLEEP_500MS, ADC_OFF, BOD_OFF); durationInMS -= 500; }
+    else if(durationInMS >= 250) { LowPower.powerDown(SLEEP_250MS, ADC_OFF, BOD_OFF); durationInMS -= 250; }
+    else if(durationInMS >= 120) { LowPower.powerDown(SLEEP_120MS, ADC_OFF, BOD_OFF); durationInMS -= 120; }
+    else if(durationInMS >= 60) { LowPower.powerDown(SLEEP_60MS, ADC_OFF, BOD_OFF); durationInMS -= 60; }
+    else if(durationInMS >= 30) { LowPower.powerDown(SLEEP_30MS, ADC_OFF, BOD_OFF); durationInMS -= 30; }
+    else { LowPower.powerDown(SLEEP_15MS, ADC_OFF, BOD_OFF); durationInMS -= 15; }
+
+  }
+
+  unsigned long idleStartMS = millis();
+
+  while((millis() - idleStartMS) < durationInMS) {
+
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_mode();
+
+  }
+
+}
+
+
+
+
+DHT22Sensor::DHT22Sensor(dht *sensor, byte dataPin, byte powerPin) {
+
+  _sensor = sensor;
+
+  _dataPin = dataPin;
+
+  _powerPin = powerPin;
+
+}
+
+
+
+unsigned int DHT22Sensor::startConversion() {
+
+  digitalWrite(_powerPin, LOW);                   // power on
+
+  _numOfReadAttempts = 0;
+
+  return DHT22_WARM_UP_TIME_IN_MS;
+
+}
+
+
+
+unsigned int DHT22Sensor::collectResult() {
+
+  unsigned int nextCollectionDelayInMS = 0;
+
+  _numOfReadAttempts++;
+
+  if(_sensor->read22(_dataPin) == DHTLIB_OK) {
+
+    temperature = _sensor->temperature;
+    humidity = _sensor->humidity;
+
+    resultAvailable = true;
+
+  }
+
+  else if(_numOfReadAttempts < DHT22_MAX_NUM_OF_READ_ATTEMPTS) nextCollectionDelayInMS = DHT22_RETRY_DELAY_IN_MS;
+
+  if(nextCollectionDelayInMS == 0) digitalWrite(_powerPin, HIGH);          // power off
+
+  return nextCollectionDelayInMS;
+
+}
+
+
+
+byte DHT22Sensor::getNumOfFields() {
+
+  return 2;
+
+}
+
+
+
+const SensorField *DHT22Sensor::getField(byte fieldIndex) {
+
+  return &DHT22_FIELDS[fieldIndex];
+
+}
+
+
+
+long DHT22Sensor::getFieldValue(byte fieldIndex) {
+
+  return toFixedPoint((fieldIndex == 0) ? temperature : humidity, DHT22_FIELDS[fieldIndex].valueNumOfDecimals);
+
+}
+
+
+
+
+BMP085PressureSensor::BMP085PressureSensor(Adafruit_BMP085 *sensor) {
+
+  _sensor = sensor;
+
+}
+
+
+
+unsigned int BMP085PressureSensor::startConversion() {
+
+  return 0;
+
+}
+
+
+
+unsigned int BMP085PressureSensor::collectResult() {
+
+  float measuredPressure = _sensor->readPressure() / 100.0;
+
+  if((measuredPressure > 900.0) and (measuredPressure < 1100.0)) {
+
+    pressure = measuredPressure;
+
+    resultAvailable = true;
+
+  }
+
+  return 0;
+
+}
+
+
+
+byte BMP085PressureSensor::getNumOfFields() {
+
+  return 1;
+
+}
+
+
+
+const SensorField *BMP085PressureSensor::getField(byte fieldIndex) {
+
+  return &BMP085_PRESSURE_FIELDS[0];
+
+}
+
+
+
+long BMP085PressureSensor::getFieldValue(byte fieldIndex) {
+
+  return toFixedPoint(pressure, BMP085_PRESSURE_FIELDS[0].valueNumOfDecimals);
+
+}
+
+
+
+
+BMP085TemperatureSensor::BMP085TemperatureSensor(Adafruit_BMP085 *sensor) {
+
+  _sensor = sensor;
+
+}
+
+
+
+unsigned int BMP085TemperatureSensor::startConversion() {
+
+  return 0;
+
+}
+
+
+
+unsigned int BMP085TemperatureSensor::collectResult() {
+
+  temperature = _sensor->readTemperature();
+
+  resultAvailable = true;
+
+  return 0;
+
+}
+
+
+
+byte BMP085TemperatureSensor::getNumOfFields() {
+
+  return 1;
+
+}
+
+
+
+const SensorField *BMP085TemperatureSensor::getField(byte fieldIndex) {
+
+  return &BMP085_TEMPERATURE_FIELDS[0];
+
+}
+
+
+
+long BMP085TemperatureSensor::getFieldValue(byte fieldIndex) {
+
+  return toFixedPoint(temperature, BMP085_TEMPERATURE_FIELDS[0].valueNumOfDecimals);
+
+}
+
+
+
+
+AnalogVoltageSensor::AnalogVoltageSensor(byte analogPin, byte numOfReadings, float voltsPerADCUnit) {
+
+  _analogPin = analogPin;
+
+  _numOfReadings = numOfReadings;
+
+  _voltsPerADCUnit = voltsPerADCUnit;
+
+}
+
+
+
+unsigned int AnalogVoltageSensor::startConversion() {
+
+  analogRead(_analogPin);                         // input selection (the first conversion after a switch is discarded)
+
+  return 0;
+
+}
+
+
+
+unsigned int AnalogVoltageSensor::collectResult() {
+
+  // each conversion is run in ADC noise reduction mode : the CPU and the I/O clocks are stopped until the conversion is complete
+
+  unsigned long accuADCReadings = 0;
+
+  ADCSRA |= _BV(ADIE);
+
+  set_sleep_mode(SLEEP_MODE_ADC);
+
+  for(byte i = 0 ; i < _numOfReadings ; i++) {
+
+    do {
+
+      sleep_mode();                               // entering the ADC noise reduction mode starts the conversion
+
+    } while(bit_is_set(ADCSRA, ADSC));
+
+    accuADCReadings += ADC;
+
+  }
+
+  ADCSRA &= ~_BV(ADIE);
+
+  if(accuADCReadings > 0) {
+
+    voltage = accuADCReadings * _voltsPerADCUnit / _numOfReadings;
+
+    resultAvailable = true;
+
+  }
+
+  return 0;
+
+}
+
+
+
+byte AnalogVoltageSensor::getNumOfFields() {
+
+  return 1;
+
+}
+
+
+
+const SensorField *AnalogVoltageSensor::getField(byte fieldIndex) {
+
+  return &ANALOG_VOLTAGE_FIELDS[0];
+
+}
+
+
+
+long AnalogVoltageSensor::getFieldValue(byte fieldIndex) {
+
+  return toFixedPoint(voltage, ANALOG_VOLTAGE_FIELDS[0].valueNumOfDecimals);
+
+}
+
+
+
+
+GPSPositionSensor::GPSPositionSensor(UltimateGPS *gps, unsigned long (*timestampFunction)(byte, byte, byte, byte, byte, byte)) {
+
+  _gps = gps;
+
+  _timestampFunction = timestampFunction;
+
+}
+
+
+
+unsigned int GPSPositionSensor::startConversion() {
+
+  return 0;
+
+}
+
+
+
+unsigned int GPSPositionSensor::collectResult() {
+
+  // the GPS module is powered on and off by the GPS acquisition task : the last position acquired is reported
+
+  resultAvailable = _gps->firstPositionAcquired;
+
+  return 0;
+
+}
+
+
+
+byte GPSPositionSensor::getNumOfFields() {
+
+  return 4;
+
+}
+
+
+
+const SensorField *GPSPositionSensor::getField(byte fieldIndex) {
+
+  return &GPS_POSITION_FIELDS[fieldIndex];
+
+}
+
+
+
+long GPSPositionSensor::getFieldValue(byte fieldIndex) {
+
+  Position *position = &(_gps->position);
+
+  switch(fieldIndex) {
+
+    case 0 : return _timestampFunction(position->fix_Y_utc, position->fix_M_utc, position->fix_D_utc, position->fix_h_utc, position->fix_m_utc, position->fix_s_utc);
+    case 1 : return position->latitudeInMicroDegrees;
+    case 2 : return position->longitudeInMicroDegrees;
+    default : return position->altitudeAboveMSLInCm;
+
+  }
+
+}
@@ -0,0 +1,350 @@
+/*
+ * File : SensorPipeline.h
+ *
+ * Version : 0.8.4
+ *
+ * Purpose : pipelined sensors acquisition for Arduino : the warm-up and conversion times of the sensors overlap, the MCU sleeps in between
+ *
+ * Author : Previmeteo (www.previmeteo.com)
+ *
+ * Project web site : http://oses.previmeteo.com/
+ *
+ * License: GNU GPL v2 (see License.txt)
+ *
+ * Creation date : 2026/10/19
+ *
+ * History :
+ *
+ * - 0.8.1 : sensors registry : report fields declared by the drivers (name, precision), per sensor sampling period
+ * - 0.8.2 : per field statistics (min / max / mean / count) of the sensors oversampled between two reports (sample())
+ * - 0.8.3 : fields triggers (range limits and max change) definition, fields lookup by name
+ * - 0.8.4 : cumulative run time (runTimeInMS), sleeping time included
+ *
+ */
+
+
+
+
+#ifndef SENSOR_PIPELINE_h
+#define SENSOR_PIPELINE_h
+
+
+
+#include "Arduino.h"
+
+#include "dht.h"
+
+#include "Adafruit_BMP085.h"
+
+#include "Ultimate_GPS.h"
+
+
+
+
+#define SENSOR_PIPELINE_MAX_NUM_OF_SENSORS 8
+
+#define SENSOR_PIPELINE_MAX_NUM_OF_STATISTICS 8                // fields of the sensors registered with statistics enabled
+
+#define FIELD_TRIGGER_NO_LIMIT 2147483647L
+
+#define DHT22_WARM_UP_TIME_IN_MS 2000
+
+#define DHT22_RETRY_DELAY_IN_MS 1000
+
+#define DHT22_MAX_NUM_OF_READ_ATTEMPTS 3
+
+
+
+
+struct SensorField {
+
+  const char *name;                             // report field name (used by the formats which write the names, e.g. JSON)
+  byte valueNumOfDecimals;                      // the values are fixed-point : value = getFieldValue() / 10^valueNumOfDecimals
+  byte reportNumOfDecimals;                     // precision of the value in the reports (<= valueNumOfDecimals)
+
+};
+
+
+
+
+struct FieldStatistics {
+
+  long minValue;                                // fixed-point, same precision as the field values
+  long maxValue;
+  long sumOfValues;
+  byte numOfValues;                             // 0 : no sample since the last resetStatistics()
+
+  long getMean() { return (sumOfValues + ((sumOfValues < 0) ? -(numOfValues / 2) : (numOfValues / 2))) / numOfValues; }       // rounded
+
+};
+
+
+
+
+struct FieldTrigger {
+
+  const char *fieldName;
+  long lowLimit;                                // fixed-point, same precision as the field values : the trigger fires when the value
+  long highLimit;                               // leaves the [lowLimit, highLimit] range (-/+ FIELD_TRIGGER_NO_LIMIT : no limit)...
+  long maxChange;                               // ... or when it changes by more than maxChange between two reports (FIELD_TRIGGER_NO_LIMIT : no limit)
+
+};
+
+
+
+
+// a sensor of the pipeline : startConversion() and collectResult() return the delay (ms) before the next collectResult() call,
+// 0 meaning that the acquisition is complete (with or without a valid result). startConversion() returns the warm-up time of the sensor
+
+class PipelinedSensor {
+
+
+  public:
+
+    boolean resultAvailable;
+
+    virtual unsigned int startConversion() = 0;
+
+    virtual unsigned int collectResult() = 0;
+
+    virtual byte getNumOfFields() = 0;
+
+    virtual const SensorField *getField(byte fieldIndex) = 0;
+
+    virtual long getFieldValue(byte fieldIndex) = 0;
+
+
+};
+
+
+
+
+class SensorPipeline {
+
+  // sensors registry : the report schema is the list of the fields of the registered sensors, in the order of registration
+
+
+  public:
+
+    unsigned long runTimeInMS;                  // cumulative duration of the runs (the sensors are powered during the runs)
+
+    SensorPipeline();
+
+    boolean addSensor(PipelinedSensor *sensor, unsigned long samplingPeriodInS, boolean statisticsEnabled = false);
+
+    byte getNumOfSensors();
+
+    PipelinedSensor *getSensor(byte sensorIndex);
+
+    boolean findField(const char *fieldName, byte *sensorIndex, byte *fieldIndex);
+
+    void run(unsigned long timestampNow);
+
+    void sample(unsigned long timestampNow);
+
+    FieldStatistics *getFieldStatistics(byte sensorIndex, byte fieldIndex);
+
+    void resetStatistics();
+
+
+  private:
+
+    PipelinedSensor *_sensors[SENSOR_PIPELINE_MAX_NUM_OF_SENSORS];
+
+    unsigned long _samplingPeriodsInS[SENSOR_PIPELINE_MAX_NUM_OF_SENSORS];
+
+    unsigned long _lastSamplingTimestamps[SENSOR_PIPELINE_MAX_NUM_OF_SENSORS];
+
+    byte _numOfSensors;
+
+    char _firstStatisticsIndexes[SENSOR_PIPELINE_MAX_NUM_OF_SENSORS];        // -1 : statistics disabled
+
+    FieldStatistics _statistics[SENSOR_PIPELINE_MAX_NUM_OF_STATISTICS];
+
+    byte _numOfStatistics;
+
+    void runSensors(unsigned long timestampNow, boolean statisticsSensorsOnly);
+
+    void updateStatistics(byte sensorIndex);
+
+    void sleepMS(unsigned long durationInMS);
+
+
+};
+
+
+
+
+class DHT22Sensor : public PipelinedSensor {
+
+  // AM2302 / DHT22 temperature and humidity sensor, powered through a (low active) power pin : fields "t" and "h"
+
+
+  public:
+
+    float temperature;
+
+    float humidity;
+
+    DHT22Sensor(dht *sensor, byte dataPin, byte powerPin);
+
+    unsigned int startConversion();
+
+    unsigned int collectResult();
+
+    byte getNumOfFields();
+
+    const SensorField *getField(byte fieldIndex);
+
+    long getFieldValue(byte fieldIndex);
+
+
+  private:
+
+    dht *_sensor;
+
+    byte _dataPin;
+
+    byte _powerPin;
+
+    byte _numOfReadAttempts;
+
+
+};
+
+
+
+
+class BMP085PressureSensor : public PipelinedSensor {
+
+  // BMP085 pressure (hPa) : field "p". The conversions are waited for by the Adafruit library (~ 30 ms)
+
+
+  public:
+
+    float pressure;
+
+    BMP085PressureSensor(Adafruit_BMP085 *sensor);
+
+    unsigned int startConversion();
+
+    unsigned int collectResult();
+
+    byte getNumOfFields();
+
+    const SensorField *getField(byte fieldIndex);
+
+    long getFieldValue(byte fieldIndex);
+
+
+  private:
+
+    Adafruit_BMP085 *_sensor;
+
+
+};
+
+
+
+
+class BMP085TemperatureSensor : public PipelinedSensor {
+
+  // BMP085 temperature (inside the station's box) : field "dev_t"
+
+
+  public:
+
+    float temperature;
+
+    BMP085TemperatureSensor(Adafruit_BMP085 *sensor);
+
+    unsigned int startConversion();
+
+    unsigned int collectResult();
+
+    byte getNumOfFields();
+
+    const SensorField *getField(byte fieldIndex);
+
+    long getFieldValue(byte fieldIndex);
+
+
+  private:
+
+    Adafruit_BMP085 *_sensor;
+
+
+};
+
+
+
+
+class AnalogVoltageSensor : public PipelinedSensor {
+
+  // averaged ADC readings, converted in ADC noise reduction sleep mode : field "bat"
+
+
+  public:
+
+    float voltage;
+
+    AnalogVoltageSensor(byte analogPin, byte numOfReadings, float voltsPerADCUnit);
+
+    unsigned int startConversion();
+
+    unsigned int collectResult();
+
+    byte getNumOfFields();
+
+    const SensorField *getField(byte fieldIndex);
+
+    long getFieldValue(byte fieldIndex);
+
+
+  private:
+
+    byte _analogPin;
+
+    byte _numOfReadings;
+
+    float _voltsPerADCUnit;
+
+
+};
+
+
+
+
+class GPSPositionSensor : public PipelinedSensor {
+
+  // last position acquired by the GPS module (no conversion) : fields "fix_ts", "lat", "lon" and "alt". The fix timestamp is computed
+  // by the sketch's timestamp function (seconds since 01 Jan 1970 00:00:00 GMT)
+
+
+  public:
+
+    GPSPositionSensor(UltimateGPS *gps, unsigned long (*timestampFunction)(byte, byte, byte, byte, byte, byte));
+
+    unsigned int startConversion();
+
+    unsigned int collectResult();
+
+    byte getNumOfFields();
+
+    const SensorField *getField(byte fieldIndex);
+
+    long getFieldValue(byte fieldIndex);
+
+
+  private:
+
+    UltimateGPS *_gps;
+
+    unsigned long (*_timestampFunction)(byte, byte, byte, byte, byte, byte);
+
+
+};
+
+
+
+#endif
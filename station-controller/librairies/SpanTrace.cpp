@@ -0,0 +1,138 @@
+/*
+ * File : SpanTrace.cpp
+ *
+ * Version : 0.8.0
+ *
+ * Purpose : spans tracing for Arduino : (event, start, duration) records kept in a RAM ring, dumped over a serial link or uploaded
+ *
+ * Author : Previmeteo (www.previmeteo.com)
+ *
+ * Project web site : http://oses.previmeteo.com/
+ *
+ * License: GNU GPL v2 (see License.txt)
+ *
+ * Creation date : 2026/10/19
+ *
+ */
+
+
+
+
+#include "Arduino.h"
+
+#include "SpanTrace.h"
+
+
+
+
+#if SPAN_TRACE_ENABLED
+
+SpanTrace spanTrace;
+
+#endif
+
+
+
+
+SpanTrace::SpanTrace() {
+
+  clear();
+
+  _paused = false;
+
+}
+
+
+
+byte SpanTrace::getNumOfRecords() {
+
+  return _numOfRecords;
+
+}
+
+
+
+SpanTraceRecord *SpanTrace::getRecord(byte recordIndex) {
+
+  // recordIndex 0 : the oldest record
+
+  if(recordIndex >= _numOfRecords) return NULL;
+
+  int ringIndex = (int) _nextRecordIndex - _numOfRecords + recordIndex;
+
+  if(ringIndex < 0) ringIndex += SPAN_TRACE_RING_SIZE;
+
+  return &_records[ringIndex];
+
+}
+
+
+
+void SpanTrace::dump(Print *output) {
+
+  // one "event,start,duration" line per record, the oldest first
+
+  for(byte recordIndex = 0 ; recordIndex < _numOfRecords ; recordIndex++) {
+
+    SpanTraceRecord *spanRecord = getRecord(recordIndex);
+
+    output->print(spanRecord->eventID);
+    output->print(',');
+    output->print(spanRecord->startMS);
+    output->print(',');
+    output->println(spanRecord->durationInMS);
+
+  }
+
+}
+
+
+
+void SpanTrace::clear() {
+
+  _nextRecordIndex = 0;
+
+  _numOfRecords = 0;
+
+}
+
+
+
+void SpanTrace::pause() {
+
+  // the spans ending while the trace is paused are not recorded (e.g. while the ring is being exported)
+
+  _paused = true;
+
+}
+
+
+
+void SpanTrace::resume() {
+
+  _paused = false;
+
+}
+
+
+
+
+SpanTraceScope::SpanTraceScope(byte eventID) {
+
+  _eventID = eventID;
+
+  _startMS = millis();
+
+}
+
+
+
+SpanTraceScope::~SpanTraceScope() {
+
+#if SPAN_TRACE_ENABLED
+
+  spanTrace.record(_eventID, _startMS);
+
+#endif
+
+}
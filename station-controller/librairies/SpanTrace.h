@@ -0,0 +1,164 @@
+/*
+ * File : SpanTrace.h
+ *
+ * Version : 0.8.0
+ *
+ * Purpose : spans tracing for Arduino : (event, start, duration) records kept in a RAM ring, dumped over a serial link or uploaded
+ *
+ * Author : Previmeteo (www.previmeteo.com)
+ *
+ * Project web site : http://oses.previmeteo.com/
+ *
+ * License: GNU GPL v2 (see License.txt)
+ *
+ * Creation date : 2026/10/19
+ *
+ * Notes :
+ *
+ * - SPAN_TRACE_ENABLED false : the TRACE_xxx macros compile to nothing and no RAM is used by the ring
+ * - a span costs two millis() calls and a 7 bytes record, the durations are saturated at 65535 ms
+ *
+ */
+
+
+
+
+#ifndef SPAN_TRACE_h
+#define SPAN_TRACE_h
+
+
+
+#include "Arduino.h"
+
+
+
+
+#define SPAN_TRACE_ENABLED false
+
+#define SPAN_TRACE_RING_SIZE 24                          // records : the oldest records are overwritten
+
+
+// events identifiers
+
+#define TRACE_EVENT_REQUEST_AT 1
+#define TRACE_EVENT_TCP_CONNECT 2
+#define TRACE_EVENT_TCP_SEND_BLOCK 3                     // one AT+CIPSEND block, up to the "SEND OK" / response
+#define TRACE_EVENT_STORE_MESSAGE 4
+#define TRACE_EVENT_RETRIEVE_MESSAGE 5
+#define TRACE_EVENT_CLEAR_PAGE 6
+#define TRACE_EVENT_ACQUIRE_NEW_POSITION 7
+#define TRACE_EVENT_TASK 16                              // TRACE_EVENT_TASK + task ID
+
+
+
+
+struct SpanTraceRecord {
+
+  byte eventID;
+  unsigned long startMS;                                  // millis() (the MCU sleeping time is not counted)
+  unsigned int durationInMS;
+
+};
+
+
+
+
+class SpanTrace {
+
+
+  public:
+
+    SpanTrace();
+
+    void record(byte eventID, unsigned long startMS) {
+
+      if(_paused) return;
+
+      unsigned long durationInMS = millis() - startMS;
+
+      SpanTraceRecord *spanRecord = &_records[_nextRecordIndex];
+
+      spanRecord->eventID = eventID;
+      spanRecord->startMS = startMS;
+      spanRecord->durationInMS = (durationInMS > 0xFFFF) ? 0xFFFF : durationInMS;
+
+      if(++_nextRecordIndex == SPAN_TRACE_RING_SIZE) _nextRecordIndex = 0;
+
+      if(_numOfRecords < SPAN_TRACE_RING_SIZE) _numOfRecords++;
+
+    }
+
+    byte getNumOfRecords();
+
+    SpanTraceRecord *getRecord(byte recordIndex);
+
+    void dump(Print *output);
+
+    void clear();
+
+    void pause();
+
+    void resume();
+
+
+  private:
+
+    SpanTraceRecord _records[SPAN_TRACE_RING_SIZE];
+
+    byte _nextRecordIndex;
+
+    byte _numOfRecords;
+
+    boolean _paused;
+
+
+};
+
+
+
+
+class SpanTraceScope {
+
+  // the span lasts as long as the object (TRACE_SPAN() macro) : it is recorded whatever the return path of the function
+
+
+  public:
+
+    SpanTraceScope(byte eventID);
+
+    ~SpanTraceScope();
+
+
+  private:
+
+    byte _eventID;
+
+    unsigned long _startMS;
+
+
+};
+
+
+
+
+#if SPAN_TRACE_ENABLED
+
+extern SpanTrace spanTrace;
+
+#define TRACE_SPAN(eventID) SpanTraceScope spanTraceScope(eventID)
+#define TRACE_SPAN_VARIABLE(startMS) unsigned long startMS
+#define TRACE_SPAN_BEGIN(startMS) startMS = millis()
+#define TRACE_SPAN_END(eventID, startMS) spanTrace.record((eventID), startMS)
+
+#else
+
+#define TRACE_SPAN(eventID)
+#define TRACE_SPAN_VARIABLE(startMS)
+#define TRACE_SPAN_BEGIN(startMS)
+#define TRACE_SPAN_END(eventID, startMS)
+
+#endif
+
+
+
+#endif
@@ -0,0 +1,256 @@
+/*
+ * File : TaskScheduler.cpp
+ *
+ * Version : 0.8.1
+ *
+ * Purpose : table-driven periodic tasks scheduler for Arduino
+ *
+ * Author : Previmeteo (www.previmeteo.com)
+ *
+ * Project web site : http://oses.previmeteo.com/
+ *
+ * License: GNU GPL v2 (see License.txt)
+ *
+ * Creation date : 2026/10/19
+ *
+ * History :
+ *
+ * - 0.8.1 : tasks coalescing : a task whose deadline falls within the coalescing window is executed in the current wake cycle
+ *           (getNextWakeTimestamp()), its deadline being consumed as if it had been reached
+ *
+ */
+
+
+
+
+#include "Arduino.h"
+
+#include "TaskScheduler.h"
+
+
+
+
+TaskScheduler::TaskScheduler() {
+
+  _numOfTasks = 0;
+
+  _coalescingWindowInS = 0;
+
+}
+
+
+
+boolean TaskScheduler::addTask(byte taskID, unsigned long periodInS, unsigned long phaseInS, unsigned long maxLatenessInS) {
+
+  if((_numOfTasks >= TASK_SCHEDULER_MAX_NUM_OF_TASKS) or (taskID == TASK_SCHEDULER_NO_TASK) or (periodInS == 0)) return false;
+
+  _taskSpecs[_numOfTasks].taskID = taskID;
+  _taskSpecs[_numOfTasks].periodInS = periodInS;
+  _taskSpecs[_numOfTasks].phaseInS = phaseInS % periodInS;
+  _taskSpecs[_numOfTasks].maxLatenessInS = maxLatenessInS;
+
+  _nextDeadlines[_numOfTasks] = 0;
+
+  _heap[_numOfTasks] = _numOfTasks;
+
+  _numOfTasks++;
+
+  return true;
+
+}
+
+
+
+boolean TaskScheduler::addTasks(const TaskSpec *taskSpecs, byte numOfTasks) {
+
+  boolean success = true;
+
+  for(byte i = 0 ; i < numOfTasks ; i++) {
+
+    if(!addTask(taskSpecs[i].taskID, taskSpecs[i].periodInS, taskSpecs[i].phaseInS, taskSpecs[i].maxLatenessInS)) success = false;
+
+  }
+
+  return success;
+
+}
+
+
+
+void TaskScheduler::setCoalescingWindow(unsigned long coalescingWindowInS) {
+
+  // 0 : no coalescing (default), each task is executed at its deadline
+
+  _coalescingWindowInS = coalescingWindowInS;
+
+}
+
+
+
+void TaskScheduler::start(unsigned long timestampNow) {
+
+  // all the deadlines are (re)computed from timestampNow : to be called again if the clock has been adjusted
+
+  for(byte taskIndex = 0 ; taskIndex < _numOfTasks ; taskIndex++) {
+
+    _nextDeadlines[taskIndex] = getFirstDeadlineFrom(taskIndex, timestampNow);
+
+    _heap[taskIndex] = taskIndex;
+
+  }
+
+  for(char heapIndex = (_numOfTasks / 2) - 1 ; heapIndex >= 0 ; heapIndex--) siftDown(heapIndex);
+
+}
+
+
+
+byte TaskScheduler::getNextTaskID(unsigned long timestampNow) {
+
+  // the deadlines missed by more than their max lateness (e.g. during a long task) are skipped : a task missed by less is
+  // executed once, as soon as possible, whatever the number of its deadlines which have been missed
+
+  if(_numOfTasks == 0) return TASK_SCHEDULER_NO_TASK;
+
+  byte taskIndex = _heap[0];
+
+  while((_nextDeadlines[taskIndex] + _taskSpecs[taskIndex].maxLatenessInS) < timestampNow) {
+
+    _nextDeadlines[taskIndex] = getFirstDeadlineFrom(taskIndex, timestampNow);
+
+    siftDown(0);
+
+    taskIndex = _heap[0];
+
+  }
+
+  return _taskSpecs[taskIndex].taskID;
+
+}
+
+
+
+unsigned long TaskScheduler::getNextTaskTimestamp() {
+
+  if(_numOfTasks == 0) return 0xFFFFFFFF;
+
+  return _nextDeadlines[_heap[0]];
+
+}
+
+
+
+unsigned long TaskScheduler::getNextWakeTimestamp(unsigned long timestampNow) {
+
+  // the next task is executed at once if its deadline falls within the coalescing window : the tasks due within a few seconds of
+  // each other are executed in the same wake cycle, in the order of their deadlines (then of the table)
+
+  unsigned long nextTaskTimestamp = getNextTaskTimestamp();
+
+  if((nextTaskTimestamp > timestampNow) and ((nextTaskTimestamp - timestampNow) <= _coalescingWindowInS)) return timestampNow;
+
+  return nextTaskTimestamp;
+
+}
+
+
+
+void TaskScheduler::taskExecuted(unsigned long timestampNow) {
+
+  // the task at the top of the queue is rescheduled to its first deadline after timestampNow (the end of its execution), or after
+  // its current deadline if it has been executed in advance (coalesced)
+
+  if(_numOfTasks == 0) return;
+
+  byte taskIndex = _heap[0];
+
+  if(timestampNow < _nextDeadlines[taskIndex]) timestampNow = _nextDeadlines[taskIndex];
+
+  _nextDeadlines[taskIndex] = getFirstDeadlineFrom(taskIndex, timestampNow + 1);
+
+  siftDown(0);
+
+}
+
+
+
+void TaskScheduler::postponeTask(byte taskID, unsigned long notBeforeTimestamp) {
+
+  // the task is moved to its first deadline at or after notBeforeTimestamp (a task is never advanced by this method)
+
+  for(byte heapIndex = 0 ; heapIndex < _numOfTasks ; heapIndex++) {
+
+    byte taskIndex = _heap[heapIndex];
+
+    if(_taskSpecs[taskIndex].taskID == taskID) {
+
+      if(_nextDeadlines[taskIndex] < notBeforeTimestamp) {
+
+        _nextDeadlines[taskIndex] = getFirstDeadlineFrom(taskIndex, notBeforeTimestamp);
+
+        siftDown(heapIndex);
+
+      }
+
+      break;
+
+    }
+
+  }
+
+}
+
+
+
+unsigned long TaskScheduler::getFirstDeadlineFrom(byte taskIndex, unsigned long timestamp) {
+
+  // constant time : first k * period + phase >= timestamp
+
+  unsigned long periodInS = _taskSpecs[taskIndex].periodInS;
+  unsigned long phaseInS = _taskSpecs[taskIndex].phaseInS;
+
+  if(timestamp <= phaseInS) return phaseInS;
+
+  return ((timestamp - phaseInS + periodInS - 1) / periodInS) * periodInS + phaseInS;
+
+}
+
+
+
+boolean TaskScheduler::isEarlier(byte taskIndex1, byte taskIndex2) {
+
+  // same deadline : the task declared first has the priority
+
+  if(_nextDeadlines[taskIndex1] != _nextDeadlines[taskIndex2]) return (_nextDeadlines[taskIndex1] < _nextDeadlines[taskIndex2]);
+
+  return (taskIndex1 < taskIndex2);
+
+}
+
+
+
+void TaskScheduler::siftDown(byte heapIndex) {
+
+  while(1) {
+
+    byte earliestIndex = heapIndex;
+
+    byte leftChildIndex = 2 * heapIndex + 1;
+    byte rightChildIndex = leftChildIndex + 1;
+
+    if((leftChildIndex < _numOfTasks) and isEarlier(_heap[leftChildIndex], _heap[earliestIndex])) earliestIndex = leftChildIndex;
+
+    if((rightChildIndex < _numOfTasks) and isEarlier(_heap[rightChildIndex], _heap[earliestIndex])) earliestIndex = rightChildIndex;
+
+    if(earliestIndex == heapIndex) break;
+
+    byte taskIndex = _heap[heapIndex];
+    _heap[heapIndex] = _heap[earliestIndex];
+    _heap[earliestIndex] = taskIndex;
+
+    heapIndex = earliestIndex;
+
+  }
+
+}
+
@@ -0,0 +1,104 @@
+/*
+ * File : TaskScheduler.h
+ *
+ * Version : 0.8.1
+ *
+ * Purpose : table-driven periodic tasks scheduler for Arduino
+ *
+ * Author : Previmeteo (www.previmeteo.com)
+ *
+ * Project web site : http://oses.previmeteo.com/
+ *
+ * License: GNU GPL v2 (see License.txt)
+ *
+ * Creation date : 2026/10/19
+ *
+ * History :
+ *
+ * - 0.8.1 : tasks coalescing : a task whose deadline falls within the coalescing window is executed in the current wake cycle
+ *           (getNextWakeTimestamp()), its deadline being consumed as if it had been reached
+ *
+ */
+
+
+
+
+#ifndef TASK_SCHEDULER_h
+#define TASK_SCHEDULER_h
+
+
+
+#include "Arduino.h"
+
+
+
+
+#define TASK_SCHEDULER_MAX_NUM_OF_TASKS 8
+
+#define TASK_SCHEDULER_NO_TASK 0
+
+
+
+
+struct TaskSpec {
+
+  byte taskID;                                              // TASK_SCHEDULER_NO_TASK is reserved
+  unsigned long periodInS;                                  // deadlines : k * periodInS + phaseInS (seconds since 01 Jan 1970 00:00:00 GMT),
+  unsigned long phaseInS;                                   // i.e. aligned on the UTC clock : {3600, 120} -> every hour at hh:02:00
+  unsigned long maxLatenessInS;                             // a deadline missed by more than maxLatenessInS is skipped
+
+};
+
+
+
+
+class TaskScheduler {
+
+
+  public:
+
+    TaskScheduler();
+
+    boolean addTask(byte taskID, unsigned long periodInS, unsigned long phaseInS, unsigned long maxLatenessInS);
+
+    boolean addTasks(const TaskSpec *taskSpecs, byte numOfTasks);
+
+    void setCoalescingWindow(unsigned long coalescingWindowInS);
+
+    void start(unsigned long timestampNow);
+
+    byte getNextTaskID(unsigned long timestampNow);
+
+    unsigned long getNextTaskTimestamp();
+
+    unsigned long getNextWakeTimestamp(unsigned long timestampNow);
+
+    void taskExecuted(unsigned long timestampNow);
+
+    void postponeTask(byte taskID, unsigned long notBeforeTimestamp);
+
+
+  private:
+
+    TaskSpec _taskSpecs[TASK_SCHEDULER_MAX_NUM_OF_TASKS];
+
+    unsigned long _nextDeadlines[TASK_SCHEDULER_MAX_NUM_OF_TASKS];
+
+    byte _heap[TASK_SCHEDULER_MAX_NUM_OF_TASKS];             // tasks indexes, binary min-heap ordered by next deadline
+
+    byte _numOfTasks;
+
+    unsigned long _coalescingWindowInS;
+
+    unsigned long getFirstDeadlineFrom(byte taskIndex, unsigned long timestamp);
+
+    boolean isEarlier(byte taskIndex1, byte taskIndex2);
+
+    void siftDown(byte heapIndex);
+
+
+};
+
+
+
+#endif
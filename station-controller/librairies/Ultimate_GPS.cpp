@@ -1,7 +1,7 @@
 /*
  * File : Ultimate_GPS.cpp
  *
- * Version : 0.8.1
+ * Version : 0.8.14
  *
  * Purpose : Ultimate GPS V3 (http://www.adafruit.com) interface library for Arduino
  *
@@ -16,6 +16,21 @@
  * History :
  *
  * - 0.8.1 : bug fixes in the acquireNewPosition() and getFieldContentFromNMEASentence() methods
+ * - 0.8.2 : incremental NMEA parser (checksum and field offsets computed on the fly, as the chars are received)
+ * - 0.8.3 : fixed-point position (micro-degrees, centimeters) decoded without atof() / float arithmetic
+ * - 0.8.4 : time / position aiding (PMTK740 / PMTK741), backup mode (PMTK225) and time-to-first-fix measurement
+ * - 0.8.5 : configure() : NMEA output mask (PMTK314), serial link baud rate (PMTK251) and update rate (PMTK220), verified with the PMTK001 acks
+ * - 0.8.6 : multi-fix acquisition (acquireAveragedPosition()) : HDOP weighted mean, outlier rejection, early exit on convergence, satellites count gate
+ * - 0.8.7 : talker-agnostic sentences dispatcher (GP, GN, GL, GA, BD...) : GGA, RMC, GSA and GSV decoders, fix mode / PDOP / VDOP acquisition criteria
+ * - 0.8.8 : bounds checks for malformed, truncated and overlong sentences (getFieldContentFromNMEASentence(), isSentenceChecksumOK(), GGA decoder), 
+ *           the library can be compiled for a host (no AVR sleep mode outside AVR targets) to replay NMEA logs
+ * - 0.8.9 : cumulative full power time (powerOnTimeInMS), from powerOn() to powerOff() / enterBackupMode()
+ * - 0.8.10 : spans tracing (see SpanTrace.h) : acquireNewPosition()
+ * - 0.8.11 : last known position persisted in EEPROM (savePosition() / restorePosition()), for the fast start of the station
+ * - 0.8.12 : the getFieldContentFromNMEASentence() and isSentenceChecksumOK() methods, unused since the incremental parser (0.8.2), are removed
+ * - 0.8.13 : a GGA fix is rejected until the date of the acquisition has been decoded from a RMC sentence
+ * - 0.8.14 : host tests (host-tests/ultimate-gps : NMEA logs replay, throughput, fuzzing) : the parseFixedPointField() and 
+ *            parseCoordinateField() results no longer overflow 32 bits with malformed fields (too many integer digits)
  * 
  */
 
@@ -25,8 +40,15 @@
 
 #include "SoftwareSerial.h"
 
+#if defined(__AVR__)
+#include <avr/sleep.h>
+#include <avr/eeprom.h>
+#endif
+
 #include "Ultimate_GPS.h"
 
+#include "SpanTrace.h"
+
 
 
 UltimateGPS::UltimateGPS(HardwareSerial *gpsSerialConnection, byte onOffPin) { 
@@ -39,6 +61,22 @@ UltimateGPS::UltimateGPS(HardwareSerial *gpsSerialConnection, byte onOffPin) {
   
   firstPositionAcquired = false;
   
+  timeToFirstFixInMS = 0;
+  
+  _inBackupMode = false;
+  
+  _powerOnMS = 0;
+  
+  _fullPower = false;
+  
+  powerOnTimeInMS = 0;
+  
+  _minFixMode = GPS_FIX_MODE_UNKNOWN;
+  
+  _pdopLimitInHundredths = 0;
+  
+  resetParser();
+  
 }
 
 
@@ -55,6 +93,22 @@ UltimateGPS::UltimateGPS(HardwareSerial *gpsSerialConnection, byte onOffPin, Sof
   
   firstPositionAcquired = false;
   
+  timeToFirstFixInMS = 0;
+  
+  _inBackupMode = false;
+  
+  _powerOnMS = 0;
+  
+  _fullPower = false;
+  
+  powerOnTimeInMS = 0;
+  
+  _minFixMode = GPS_FIX_MODE_UNKNOWN;
+  
+  _pdopLimitInHundredths = 0;
+  
+  resetParser();
+  
 }
 
 
@@ -64,6 +118,10 @@ void UltimateGPS::init(unsigned long baudRate) {
   pinMode(_onOffPin, OUTPUT);    
   digitalWrite(_onOffPin, LOW); 
   
+  _defaultBaudRate = baudRate;
+  
+  _baudRate = baudRate;
+  
   _gpsSerialConnection->begin(baudRate);
   
   delay(1000);
@@ -73,9 +131,23 @@ void UltimateGPS::init(unsigned long baudRate) {
 
 
 void UltimateGPS::powerOn() {
+  
+  _powerOnMS = millis();
+  
+  _fullPower = true;
 
   digitalWrite(_onOffPin, HIGH);
   
+  if(_inBackupMode) {
+    
+    // the receiver leaves the backup mode as soon as it receives a char
+    
+    _gpsSerialConnection->print("\r\n");
+    
+    _inBackupMode = false;
+    
+  }
+  
   delay(2000);
   
 }
@@ -86,293 +158,1103 @@ void UltimateGPS::powerOff() {
   
   digitalWrite(_onOffPin, LOW);
   
+  if(_fullPower) powerOnTimeInMS += millis() - _powerOnMS;
+  
+  _fullPower = false;
+  
+  _inBackupMode = false;
+  
+  if(_baudRate != _defaultBaudRate) setSerialBaudRate(_defaultBaudRate);             // the receiver restarts at its default rate
+  
   delay(500);
   
 }
 
-    
-    
-void UltimateGPS::configure() {
+
+
+void UltimateGPS::enterBackupMode() {
   
-  Serial.print("$PMTK220,1000*1F\r\n");                                       // update frequency is set to 1 Hz
+  // the receiver stays powered, but only its RTC and its backup RAM (ephemeris, last position) are kept alive : 
+  // the next acquisition is then a hot start
   
-  Serial.flush();
+  sendPMTKCommand("PMTK225,4");
   
-  delay(1000);
+  if(_fullPower) powerOnTimeInMS += millis() - _powerOnMS;
+  
+  _fullPower = false;
+  
+  _inBackupMode = true;
+  
+  delay(500);
   
 }
 
 
 
-boolean UltimateGPS::acquireNewPosition(float accuracyLimit, int timeoutInS) {
-    
-  boolean newPositionAcquired = false;
+boolean UltimateGPS::isInBackupMode() {
   
-  unsigned long newPositionAcquisitionStartMS;
+  return _inBackupMode;
   
-  unsigned long timeoutInMS = (unsigned long)timeoutInS * 1000;
+}
+
+    
+    
+boolean UltimateGPS::configure() {
   
-  unsigned long lineReadStartMS;
+  // only the GGA and RMC sentences are output, at 1 Hz, on the current serial link
   
-  char gpsRxBuffer[GPS_NMEA_SENTENCE_BUFFER_SIZE];
+  return configure(GPS_NMEA_OUTPUT_DEFAULT_MASK, 0, GPS_DEFAULT_UPDATE_PERIOD_IN_MS);
   
-  byte numOfCharsReceived; 
+}
+
+
+
+boolean UltimateGPS::configure(byte nmeaOutputMask, unsigned long baudRate, unsigned int updatePeriodInMS) {
   
-  boolean newLineReceived;
+  // baudRate : 0 to keep the current rate of the serial link
   
-  boolean newNMEASentenceReceived;
+  char command[GPS_PMTK_COMMAND_BUFFER_SIZE];
   
-  char stringBuffer[12];
+  boolean configured;
   
-  float horizontalDilutionOfPrecision;
+  // NMEA output mask : "PMTK314,GLL,RMC,VTG,GGA,GSA,GSV,0,...,0" (19 fields)
   
-  byte currentDate_Y = 0;
-  byte currentDate_M = 0;
-  byte currentDate_D = 0;
+  strcpy(command, "PMTK314");
   
+  for(byte i = 0 ; i < 19 ; i++) {
+    
+    if((i < 6) and bitRead(nmeaOutputMask, i)) strcat(command, ",1");
+    else strcat(command, ",0");
+    
+  }
   
-  newPositionAcquisitionStartMS = millis();
+  configured = sendPMTKCommandAndWaitForAck(command, GPS_PMTK_ACK_TIMEOUT_IN_MS);
   
-  while (((millis() - newPositionAcquisitionStartMS) < timeoutInMS) and !newPositionAcquired) {
+  if(!configured and (_baudRate != _defaultBaudRate)) {
     
- 
-    // new line reading
+    // the receiver has lost its configuration (power off) : it is back to its default rate
+    
+    setSerialBaudRate(_defaultBaudRate);
+    
+    configured = sendPMTKCommandAndWaitForAck(command, GPS_PMTK_ACK_TIMEOUT_IN_MS);
+    
+  }
+  
+  unsigned long previousBaudRate = _baudRate;
   
-    newLineReceived = false;
+  if(configured and (baudRate != 0) and (baudRate != _baudRate)) {
     
-    numOfCharsReceived = 0;  
-
-    lineReadStartMS = millis();  
+    // the PMTK251 command is not acknowledged : the new rate is verified with the next command
     
-    while((numOfCharsReceived < (GPS_NMEA_SENTENCE_BUFFER_SIZE - 1)) and !newLineReceived) {
-      
-      while((millis() - lineReadStartMS < 1500) and !Serial.available());   
-      
-      char c = Serial.read();
-      
-      gpsRxBuffer[numOfCharsReceived] = c;
-      
-      if(c == '\n') newLineReceived = true;
-      
-      numOfCharsReceived++;
-      
-    } 
+    strcpy(command, "PMTK251,");
+    appendNumber(command, baudRate, 1);
     
+    sendPMTKCommand(command);
     
-    // is the NMEA sentence valid ? 
+    delay(100);
     
-    newNMEASentenceReceived = false;
+    setSerialBaudRate(baudRate);
     
-    if(newLineReceived) {
-      
-      gpsRxBuffer[numOfCharsReceived - 2] = '\0';
-      gpsRxBuffer[numOfCharsReceived - 1] = '\0';
-      
-      newNMEASentenceReceived = isSentenceChecksumOK(gpsRxBuffer);
-      
-    }
+  }
+  
+  if(configured) {
     
+    strcpy(command, "PMTK220,");
+    appendNumber(command, updatePeriodInMS, 1);
     
-    // specific treatments according to the NMEA sentence type
+    configured = sendPMTKCommandAndWaitForAck(command, GPS_PMTK_ACK_TIMEOUT_IN_MS);
     
-    if(newNMEASentenceReceived) {   
+    if(!configured and (_baudRate != previousBaudRate)) setSerialBaudRate(previousBaudRate);
     
-      if(DEBUG_MODE and _debugSerialConnectionEnabled) _debugSerialConnection->println(gpsRxBuffer);
-      
-      if(strstr(gpsRxBuffer, "GPRMC") != NULL) {      
-        
-        // sentence type is GPRMC
-        
-        getFieldContentFromNMEASentence(gpsRxBuffer, stringBuffer, 9);
-        
-        byte Y = (stringBuffer[4] - '0') * 10 + (stringBuffer[5] - '0');
-          
-        if(Y < 80) {
-          
-          currentDate_Y = Y;
-          currentDate_M = (stringBuffer[2] - '0') * 10 + (stringBuffer[3] - '0');
-          currentDate_D = (stringBuffer[0] - '0') * 10 + (stringBuffer[1] - '0');
+  }
+  
+  return configured;
+  
+}
 
-        }
-        
-      }
-     
-      
-      else if(strstr(gpsRxBuffer, "GPGGA") != NULL) {      
-        
-        // sentence type is GPGGA
 
-        getFieldContentFromNMEASentence(gpsRxBuffer, stringBuffer, 6);                  // stringBuffer -> fix quality string
-        
-        if((stringBuffer[0] == '1') or (stringBuffer[0] == '2')) {
-        
-          getFieldContentFromNMEASentence(gpsRxBuffer, stringBuffer, 8);                // stringBuffer -> horizontal dilution of precision
-       
-          if(strlen(stringBuffer) > 0) {
-           
-            horizontalDilutionOfPrecision = (float) atof(stringBuffer);
-            
-            if((horizontalDilutionOfPrecision > 0) and (horizontalDilutionOfPrecision < accuracyLimit)) newPositionAcquired = true;
-            
-          }
-          
-        }
-    
-        if(newPositionAcquired) {
-          
-          // fix time
-      
-          getFieldContentFromNMEASentence(gpsRxBuffer, stringBuffer, 1);               //  stringBuffer -> current time string
-          
-          position.fix_Y_utc = currentDate_Y;
-          position.fix_M_utc = currentDate_M;
-          position.fix_D_utc = currentDate_D;
-          
-          position.fix_h_utc = (stringBuffer[0] - '0') * 10 + (stringBuffer[1] - '0');
-          position.fix_m_utc = (stringBuffer[2] - '0') * 10 + (stringBuffer[3] - '0');
-          position.fix_s_utc = (stringBuffer[4] - '0') * 10 + (stringBuffer[5] - '0');
-          
-          
-          // latitude
-          
-          getFieldContentFromNMEASentence(gpsRxBuffer, stringBuffer, 2);              
-          
-          float encodedLatitude = (float) atof(stringBuffer);
-          
-          position.latitude =  int(encodedLatitude / 100.0) + ((encodedLatitude - int(encodedLatitude / 100.0) * 100) / 60.0);  
-        
-          getFieldContentFromNMEASentence(gpsRxBuffer, stringBuffer, 3);              
-       
-          if(stringBuffer[0] == 'S') position.latitude = -position.latitude;
-        
+
+void UltimateGPS::sendTimeAiding(byte year2K, byte month, byte day, byte hour, byte minute, byte second) {
   
-          // longitude
-          
-          getFieldContentFromNMEASentence(gpsRxBuffer, stringBuffer, 4);              
-          
-          float encodedLongitude = (float) atof(stringBuffer); 
-          
-          position.longitude = int(encodedLongitude / 100.0) + ((encodedLongitude - int(encodedLongitude / 100.0) * 100) / 60.0);  
-        
-          getFieldContentFromNMEASentence(gpsRxBuffer, stringBuffer, 5);             
-     
-          if(stringBuffer[0] == 'W') position.longitude = -position.longitude;
-         
-          
-          // altitudeAboveMSL
-          
-          getFieldContentFromNMEASentence(gpsRxBuffer, stringBuffer, 9);              
-          
-          position.altitudeAboveMSL = (float) atof(stringBuffer);        
-          
-          position.horizontalDilutionOfPrecision = horizontalDilutionOfPrecision;
-   
+  // UTC time aiding : "$PMTK740,YYYY,MM,DD,hh,mm,ss*CS"
   
-          if(!firstPositionAcquired) firstPositionAcquired = true;
-      
-    
-        }  
+  char command[GPS_PMTK_COMMAND_BUFFER_SIZE];
   
-        
-      } 
-      
-      
-    }
-    
-    
-  }
+  strcpy(command, "PMTK740,");
   
-  return newPositionAcquired;
+  appendDateTime(command, year2K, month, day, hour, minute, second);
+  
+  sendPMTKCommand(command);
+  
+}
+
+
+
+void UltimateGPS::sendPositionAiding(long latitudeInMicroDegrees, long longitudeInMicroDegrees, long altitudeAboveMSLInCm, 
+                                     byte year2K, byte month, byte day, byte hour, byte minute, byte second) {
+  
+  // reference position aiding : "$PMTK741,Lat,Long,Alt,YYYY,MM,DD,hh,mm,ss*CS" (decimal degrees, meters, current UTC time)
+  
+  char command[GPS_PMTK_COMMAND_BUFFER_SIZE];
+  
+  strcpy(command, "PMTK741,");
+  
+  appendFixedPoint(command, latitudeInMicroDegrees, 6);
+  strcat(command, ",");
+  
+  appendFixedPoint(command, longitudeInMicroDegrees, 6);
+  strcat(command, ",");
+  
+  appendNumber(command, altitudeAboveMSLInCm / 100, 1);
+  strcat(command, ",");
+  
+  appendDateTime(command, year2K, month, day, hour, minute, second);
+  
+  sendPMTKCommand(command);
   
 }
 
 
+
+void UltimateGPS::sendPMTKCommand(char *command) {
+  
+  // command example : "PMTK220,1000" (the '$' and the checksum are added here)
+  
+  char checksum = 0;
+  
+  for(byte i = 0 ; command[i] != '\0' ; i++) checksum = char(checksum ^ command[i]);
+  
+  char hexDigits[] = "0123456789ABCDEF";
+  
+  _gpsSerialConnection->print('$');
+  _gpsSerialConnection->print(command);
+  _gpsSerialConnection->print('*');
+  _gpsSerialConnection->print(hexDigits[(checksum >> 4) & 0x0F]);
+  _gpsSerialConnection->print(hexDigits[checksum & 0x0F]);
+  _gpsSerialConnection->print("\r\n");
+  
+  _gpsSerialConnection->flush();
+  
+  if(DEBUG_MODE and _debugSerialConnectionEnabled) {
     
-void UltimateGPS::getFieldContentFromNMEASentence(char *nmeaSentence, char *fieldData, byte fieldIndex) {
- 
-  char fieldDelimiter = ',';
+    _debugSerialConnection->print("-> ");
+    _debugSerialConnection->println(command);
+    
+  }
+  
+}
 
-  boolean fieldFound = false;
 
-  byte charIndex = 0;
-  byte fieldCounter = 0;
 
-  byte fieldStartIndex = 0;
-  byte fieldDataLength = sizeof(nmeaSentence) - 1;
+boolean UltimateGPS::sendPMTKCommandAndWaitForAck(char *command, long timeOutInMS) {
+  
+  // the receiver answers "$PMTK001,Cmd,Flag*CS" (Flag : 0 = invalid command, 1 = unsupported, 2 = action failed, 3 = action succeeded)
+  
+  char commandNumber[4];
   
-  while((nmeaSentence[charIndex] != '\0') and (charIndex < (GPS_NMEA_SENTENCE_BUFFER_SIZE - 1)) and (!fieldFound)) {
+  strncpy(commandNumber, command + 4, 3);                         // "PMTK220,1000" -> "220"
+  commandNumber[3] = '\0';
+  
+  resetParser();
+  
+  sendPMTKCommand(command);
+  
+  boolean ackReceived = false;
+  
+  boolean commandSucceeded = false;
+  
+  unsigned long clockTimeOut = millis() + timeOutInMS;
+  
+  while((millis() < clockTimeOut) and !ackReceived) {
     
-    if(nmeaSentence[charIndex] == fieldDelimiter) {
+    if(_gpsSerialConnection->available() > 0) {
       
-      if(fieldCounter == 0) fieldDataLength = charIndex;
-      
-      else {
+      if(encode(_gpsSerialConnection->read()) and isSentenceType("PMTK001") and (strncmp(getFieldPointer(1), commandNumber, 3) == 0)) {
         
-        fieldStartIndex = fieldStartIndex + fieldDataLength + 1;
-        fieldDataLength = charIndex - fieldStartIndex;
+        ackReceived = true;
+        
+        commandSucceeded = (*getFieldPointer(2) == '3');
         
       }
-
-      if (fieldCounter == fieldIndex) fieldFound = true;
-
-      fieldCounter++; 
-
+      
     }
     
-    charIndex++;
-
-  }  
+  }
   
-  if(fieldFound) {
+  if(DEBUG_MODE and _debugSerialConnectionEnabled) {
     
-    char* fieldStartPointer = nmeaSentence + fieldStartIndex;
+    _debugSerialConnection->print("PMTK");
+    _debugSerialConnection->print(commandNumber);
+    
+    if(commandSucceeded) _debugSerialConnection->println(" ack");
+    else _debugSerialConnection->println(" no ack");
     
-    strncpy(fieldData, fieldStartPointer, fieldDataLength); 
-      
-    fieldData[fieldDataLength] = '\0';
-  
   }
   
-  else {
+  return commandSucceeded;
+  
+}
+
+
+
+void UltimateGPS::setSerialBaudRate(unsigned long baudRate) {
+  
+  _gpsSerialConnection->end();
+  
+  _gpsSerialConnection->begin(baudRate);
+  
+  _baudRate = baudRate;
+  
+}
+
+
+
+void UltimateGPS::appendNumber(char *buffer, long value, byte minNumOfDigits) {
+  
+  // the number is left padded with '0' up to minNumOfDigits digits
+  
+  byte length = strlen(buffer);
+  
+  if(value < 0) {
     
-    fieldData[0] = '\0';
+    buffer[length++] = '-';
+    value = -value;
     
   }
   
+  char digits[11];
+  
+  ultoa(value, digits, 10);
+  
+  for(byte i = strlen(digits) ; i < minNumOfDigits ; i++) buffer[length++] = '0';
+  
+  strcpy(buffer + length, digits);
+  
 }
+
+
+
+void UltimateGPS::appendFixedPoint(char *buffer, long value, byte numOfDecimals) {
+  
+  long divider = 1;
+  
+  for(byte i = 0 ; i < numOfDecimals ; i++) divider *= 10;
+  
+  if(value < 0) {
     
+    strcat(buffer, "-");
+    value = -value;
     
- 
-boolean UltimateGPS::isSentenceChecksumOK(char *sentence) {
+  }
+  
+  appendNumber(buffer, value / divider, 1);
+  strcat(buffer, ".");
+  appendNumber(buffer, value % divider, numOfDecimals);
   
-  boolean checkResult = false;
+}
+
+
+
+void UltimateGPS::appendDateTime(char *buffer, byte year2K, byte month, byte day, byte hour, byte minute, byte second) {
   
-  byte sentenceLength = 0;
+  // "YYYY,MM,DD,hh,mm,ss"
   
-  while((sentence[sentenceLength] != '\0') and (sentenceLength < GPS_NMEA_SENTENCE_BUFFER_SIZE)) sentenceLength++;
+  appendNumber(buffer, 2000 + year2K, 4);
+  strcat(buffer, ",");
+  appendNumber(buffer, month, 2);
+  strcat(buffer, ",");
+  appendNumber(buffer, day, 2);
+  strcat(buffer, ",");
+  appendNumber(buffer, hour, 2);
+  strcat(buffer, ",");
+  appendNumber(buffer, minute, 2);
+  strcat(buffer, ",");
+  appendNumber(buffer, second, 2);
+  
+}
+
+
 
-  char c;
+void UltimateGPS::setAcquisitionCriteria(byte minFixMode, float pdopLimit) {
   
-  char computedChecksum = 0;
+  // additional criteria for the acceptance of a fix, checked against the last GSA sentence (the GSA output must be enabled, see configure()) : 
+  // minFixMode = GPS_FIX_MODE_UNKNOWN and pdopLimit = 0 to disable them
+  
+  _minFixMode = minFixMode;
+  
+  _pdopLimitInHundredths = (int) (pdopLimit * 100);
+  
+}
 
-  for (byte i = 1; i < (sentenceLength - 3); i++) {              
-    
-    c = sentence[i];
-    computedChecksum = char(computedChecksum ^ c);
-    
-  } 
 
-  char payloadChecksum = hexCharToChar(sentence[sentenceLength - 2]) * 16 + hexCharToChar(sentence[sentenceLength - 1]);
+
+boolean UltimateGPS::acquireNewPosition(float accuracyLimit, int timeoutInS) {
   
-  if(computedChecksum == payloadChecksum) checkResult = true;
+  // the first fix with an HDOP lower than accuracyLimit is stored in position
   
-  return checkResult;
+  TRACE_SPAN(TRACE_EVENT_ACQUIRE_NEW_POSITION);
+  
+  beginAcquisition();
+  
+  boolean newPositionAcquired = waitForNextFix(accuracyLimit, 0, millis(), (unsigned long)timeoutInS * 1000);
+  
+  if(newPositionAcquired) position.numOfAveragedFixes = 1;
+  
+  return newPositionAcquired;
   
 }
+
+
+
+boolean UltimateGPS::acquireAveragedPosition(float accuracyLimit, byte minNumOfSatellites, byte maxNumOfFixes, int averagingWindowInS, int convergenceRadiusInCm, int timeoutInS) {
+  
+  // up to maxNumOfFixes fixes are collected during averagingWindowInS seconds (counted from the first fix) : the position stored in 
+  // position is their HDOP weighted mean (weight = 1 / HDOP^2), after the rejection of the outliers.
+  // The acquisition stops early when adding a new fix moves the estimate by less than convergenceRadiusInCm.
+  
+  long fixLatitudes[GPS_AVERAGING_MAX_NUM_OF_FIXES];                 // micro-degrees
+  long fixLongitudes[GPS_AVERAGING_MAX_NUM_OF_FIXES];
+  long fixAltitudes[GPS_AVERAGING_MAX_NUM_OF_FIXES];                 // centimeters
+  int fixHDOPs[GPS_AVERAGING_MAX_NUM_OF_FIXES];                      // hundredths
+  
+  if(maxNumOfFixes > GPS_AVERAGING_MAX_NUM_OF_FIXES) maxNumOfFixes = GPS_AVERAGING_MAX_NUM_OF_FIXES;
+  
+  byte numOfFixes = 0;
+  
+  boolean converged = false;
+  
+  float sumOfWeights = 0;
+  float weightedLatitudeOffsetsSum = 0;                               // offsets from the first fix (micro-degrees) : no loss of precision in a float
+  float weightedLongitudeOffsetsSum = 0;
+  
+  long estimatedLatitude = 0;
+  long estimatedLongitude = 0;
+  
+  unsigned long acquisitionStartMS = millis();
+  unsigned long timeoutInMS = (unsigned long)timeoutInS * 1000;
+  
+  unsigned long averagingStartMS = 0;
+  unsigned long averagingWindowInMS = (unsigned long)averagingWindowInS * 1000;
+  
+  beginAcquisition();
+  
+  while((numOfFixes < maxNumOfFixes) and !converged) {
     
+    boolean newFixAcquired;
     
+    if(numOfFixes == 0) newFixAcquired = waitForNextFix(accuracyLimit, minNumOfSatellites, acquisitionStartMS, timeoutInMS);
+    else newFixAcquired = waitForNextFix(accuracyLimit, minNumOfSatellites, averagingStartMS, averagingWindowInMS);
     
-   
+    if(!newFixAcquired) break;
+    
+    if(numOfFixes == 0) averagingStartMS = millis();
+    
+    fixLatitudes[numOfFixes] = position.latitudeInMicroDegrees;
+    fixLongitudes[numOfFixes] = position.longitudeInMicroDegrees;
+    fixAltitudes[numOfFixes] = position.altitudeAboveMSLInCm;
+    fixHDOPs[numOfFixes] = position.horizontalDilutionOfPrecisionInHundredths;
+    
+    float weight = 1.0 / ((float) fixHDOPs[numOfFixes] * fixHDOPs[numOfFixes]);
+    
+    sumOfWeights += weight;
+    weightedLatitudeOffsetsSum += weight * (fixLatitudes[numOfFixes] - fixLatitudes[0]);
+    weightedLongitudeOffsetsSum += weight * (fixLongitudes[numOfFixes] - fixLongitudes[0]);
+    
+    long previousEstimatedLatitude = estimatedLatitude;
+    long previousEstimatedLongitude = estimatedLongitude;
+    
+    estimatedLatitude = fixLatitudes[0] + (long) (weightedLatitudeOffsetsSum / sumOfWeights);
+    estimatedLongitude = fixLongitudes[0] + (long) (weightedLongitudeOffsetsSum / sumOfWeights);
+    
+    numOfFixes++;
+    
+    if(numOfFixes >= GPS_AVERAGING_MIN_NUM_OF_FIXES) {
+      
+      converged = (getDistanceInCm(estimatedLatitude, estimatedLongitude, previousEstimatedLatitude, previousEstimatedLongitude) < convergenceRadiusInCm);
+      
+    }
+    
+  }
+  
+  if(numOfFixes == 0) return false;
+  
+  
+  // outliers rejection : fixes farther than GPS_OUTLIER_REJECTION_FACTOR * median distance (and than the convergence radius) from the 
+  // median position (median latitude, median longitude), which is not pulled by the outliers as a mean would be
+  
+  long sortedValues[GPS_AVERAGING_MAX_NUM_OF_FIXES];
+  
+  long medianLatitude = getMedian(fixLatitudes, sortedValues, numOfFixes);
+  long medianLongitude = getMedian(fixLongitudes, sortedValues, numOfFixes);
+  
+  long distancesInCm[GPS_AVERAGING_MAX_NUM_OF_FIXES];
+  
+  for(byte i = 0 ; i < numOfFixes ; i++) distancesInCm[i] = (long) getDistanceInCm(fixLatitudes[i], fixLongitudes[i], medianLatitude, medianLongitude);
+  
+  long rejectionDistanceInCm = GPS_OUTLIER_REJECTION_FACTOR * getMedian(distancesInCm, sortedValues, numOfFixes);
+  
+  if(rejectionDistanceInCm < convergenceRadiusInCm) rejectionDistanceInCm = convergenceRadiusInCm;
+  
+  if(numOfFixes < GPS_AVERAGING_MIN_NUM_OF_FIXES) rejectionDistanceInCm = -1;          // not enough fixes to detect the outliers : all the fixes are kept
+  
+  
+  // final weighted mean, with the remaining fixes
+  
+  sumOfWeights = 0;
+  weightedLatitudeOffsetsSum = 0;
+  weightedLongitudeOffsetsSum = 0;
+  
+  float weightedAltitudeOffsetsSum = 0;
+  
+  int lowestHDOP = 0;
+  
+  byte numOfAveragedFixes = 0;
+  
+  for(byte i = 0 ; i < numOfFixes ; i++) {
+    
+    if((rejectionDistanceInCm >= 0) and (distancesInCm[i] > rejectionDistanceInCm)) continue;
+    
+    float weight = 1.0 / ((float) fixHDOPs[i] * fixHDOPs[i]);
+    
+    sumOfWeights += weight;
+    weightedLatitudeOffsetsSum += weight * (fixLatitudes[i] - fixLatitudes[0]);
+    weightedLongitudeOffsetsSum += weight * (fixLongitudes[i] - fixLongitudes[0]);
+    weightedAltitudeOffsetsSum += weight * (fixAltitudes[i] - fixAltitudes[0]);
+    
+    if((lowestHDOP == 0) or (fixHDOPs[i] < lowestHDOP)) lowestHDOP = fixHDOPs[i];
+    
+    numOfAveragedFixes++;
+    
+  }
+  
+  // the fix time and the satellites count of the last fix are kept
+  
+  position.latitudeInMicroDegrees = fixLatitudes[0] + (long) (weightedLatitudeOffsetsSum / sumOfWeights);
+  position.longitudeInMicroDegrees = fixLongitudes[0] + (long) (weightedLongitudeOffsetsSum / sumOfWeights);
+  position.altitudeAboveMSLInCm = fixAltitudes[0] + (long) (weightedAltitudeOffsetsSum / sumOfWeights);
+  position.horizontalDilutionOfPrecisionInHundredths = lowestHDOP;
+  position.numOfAveragedFixes = numOfAveragedFixes;
+  
+  if(DEBUG_MODE and _debugSerialConnectionEnabled) {
+    
+    _debugSerialConnection->print("averaged fixes : ");
+    _debugSerialConnection->print(numOfAveragedFixes);
+    _debugSerialConnection->print(" / ");
+    _debugSerialConnection->println(numOfFixes);
+    
+  }
+  
+  return true;
+  
+}
+
+
+
+void UltimateGPS::beginAcquisition() {
+  
+  _currentDate_Y = 0;
+  _currentDate_M = 0;
+  _currentDate_D = 0;
+  
+  timeToFirstFixInMS = 0;
+  
+  fixQuality.fixMode = GPS_FIX_MODE_UNKNOWN;
+  fixQuality.positionDilutionOfPrecisionInHundredths = 0;
+  fixQuality.horizontalDilutionOfPrecisionInHundredths = 0;
+  fixQuality.verticalDilutionOfPrecisionInHundredths = 0;
+  fixQuality.numOfSatellitesInUse = 0;
+  fixQuality.numOfSatellitesInView = 0;
+  
+  for(byte i = 0 ; i < GPS_NUM_OF_CONSTELLATIONS ; i++) _numOfSatellitesInView[i] = 0;
+  
+  if(_powerOnMS == 0) _powerOnMS = millis();
+  
+  resetParser();
+  
+}
+
+
+
+boolean UltimateGPS::waitForNextFix(float accuracyLimit, byte minNumOfSatellites, unsigned long startMS, unsigned long timeoutInMS) {
+  
+  // the chars stored by the serial receive interrupt are decoded one by one as they arrive (see encode()), and the MCU sleeps 
+  // (idle mode, woken up by the next received char) when the receive buffer is empty
+    
+  boolean newPositionAcquired = false;
+  
+  while (((millis() - startMS) < timeoutInMS) and !newPositionAcquired) {
+    
+    if(_gpsSerialConnection->available() > 0) {
+      
+      if(encode(_gpsSerialConnection->read())) {
+        
+        // a new valid NMEA sentence has been received : specific treatments according to its type
+    
+        if(DEBUG_MODE and _debugSerialConnectionEnabled) _debugSerialConnection->println(_sentenceBuffer);
+        
+        newPositionAcquired = decodeSentence(accuracyLimit, minNumOfSatellites);
+        
+      }
+      
+    }
+    
+    else {
+      
+      #if defined(__AVR__)
+      set_sleep_mode(SLEEP_MODE_IDLE);
+      sleep_mode();
+      #endif
+      
+    }
+    
+  }
+  
+  return newPositionAcquired;
+  
+}
+
+
+
+boolean UltimateGPS::decodeSentence(float accuracyLimit, byte minNumOfSatellites) {
+  
+  // the sentences are dispatched according to their formatter only : the talker ID (GP = GPS, GL = GLONASS, GA = Galileo, 
+  // GN = multi-constellation...) is ignored. Returns true if the sentence is a GGA sentence whose fix has been accepted.
+  
+  boolean newPositionAcquired = false;
+  
+  if(isSentenceFormatter("GGA")) newPositionAcquired = decodeGGASentence(accuracyLimit, minNumOfSatellites);
+  
+  else if(isSentenceFormatter("RMC")) decodeRMCSentence();
+  
+  else if(isSentenceFormatter("GSA")) decodeGSASentence();
+  
+  else if(isSentenceFormatter("GSV")) decodeGSVSentence();
+  
+  return newPositionAcquired;
+  
+}
+
+
+
+void UltimateGPS::savePosition(int eepromAddress) {
+  
+  // to be called after a successful acquisition (EEPROM writes : one per acquisition)
+  
+#if defined(__AVR__)
+  
+  PositionEEPROMEntry positionEntry;
+  
+  positionEntry.marker = GPS_POSITION_EEPROM_MARKER;
+  positionEntry.position = position;
+  
+  eeprom_write_block((const void *) &positionEntry, (void *) eepromAddress, sizeof(positionEntry));
+  
+#endif
+  
+}
+
+
+
+boolean UltimateGPS::restorePosition(int eepromAddress) {
+  
+  // the last known position (and its fix date / time) is restored as if it had just been acquired : false if the entry has never 
+  // been written (or on a host)
+  
+#if defined(__AVR__)
+  
+  PositionEEPROMEntry positionEntry;
+  
+  eeprom_read_block((void *) &positionEntry, (const void *) eepromAddress, sizeof(positionEntry));
+  
+  if(positionEntry.marker != GPS_POSITION_EEPROM_MARKER) return false;
+  
+  position = positionEntry.position;
+  
+  firstPositionAcquired = true;
+  
+  return true;
+  
+#else
+  
+  return false;
+  
+#endif
+  
+}
+
+
+
+float UltimateGPS::getDistanceInCm(long latitude1InMicroDegrees, long longitude1InMicroDegrees, long latitude2InMicroDegrees, long longitude2InMicroDegrees) {
+  
+  // equirectangular approximation : accurate enough for the short distances between the fixes of a same site
+  
+  float northOffsetInCm = (latitude1InMicroDegrees - latitude2InMicroDegrees) * GPS_CM_PER_MICRO_DEGREE_OF_LATITUDE;
+  float eastOffsetInCm = (longitude1InMicroDegrees - longitude2InMicroDegrees) * GPS_CM_PER_MICRO_DEGREE_OF_LATITUDE * cos(latitude1InMicroDegrees * (DEG_TO_RAD / 1000000.0));
+  
+  return sqrt(northOffsetInCm * northOffsetInCm + eastOffsetInCm * eastOffsetInCm);
+  
+}
+
+
+
+long UltimateGPS::getMedian(long *values, long *sortedValues, byte numOfValues) {
+  
+  // values are copied to sortedValues, then sorted (insertion sort : numOfValues <= GPS_AVERAGING_MAX_NUM_OF_FIXES)
+  
+  for(byte i = 0 ; i < numOfValues ; i++) {
+    
+    byte j = i;
+    
+    while((j > 0) and (sortedValues[j - 1] > values[i])) {
+      
+      sortedValues[j] = sortedValues[j - 1];
+      j--;
+      
+    }
+    
+    sortedValues[j] = values[i];
+    
+  }
+  
+  return sortedValues[numOfValues / 2];
+  
+}
+
+
+
+boolean UltimateGPS::encode(char c) {
+  
+  // single pass NMEA parser : the checksum and the offsets of the fields are computed as the chars are received 
+  // returns true when a complete sentence with a valid checksum is available in _sentenceBuffer ("$...*hh", without "\r\n")
+  
+  boolean validSentenceReceived = false;
+  
+  if(c == '$') {
+    
+    _sentenceBuffer[0] = c;
+    _sentenceLength = 1;
+    
+    _fieldOffsets[0] = 1;
+    _numOfFields = 1;
+    
+    _computedChecksum = 0;
+    
+    _parserState = GPS_PARSER_STATE_IN_SENTENCE;
+    
+  }
+  
+  else if(_parserState != GPS_PARSER_STATE_WAITING_START) {
+    
+    if((_sentenceLength >= (GPS_NMEA_SENTENCE_BUFFER_SIZE - 1)) or (c == '\r') or (c == '\n')) {
+      
+      // overlong or truncated sentence : dropped
+      
+      _parserState = GPS_PARSER_STATE_WAITING_START;
+      
+    }
+    
+    else {
+      
+      _sentenceBuffer[_sentenceLength] = c;
+      _sentenceLength++;
+      
+      if(_parserState == GPS_PARSER_STATE_IN_SENTENCE) {
+        
+        if(c == '*') {
+          
+          _receivedChecksum = 0;
+          _numOfChecksumDigitsReceived = 0;
+          
+          _parserState = GPS_PARSER_STATE_IN_CHECKSUM;
+          
+        }
+        
+        else {
+          
+          _computedChecksum = char(_computedChecksum ^ c);
+          
+          if((c == ',') and (_numOfFields < GPS_NMEA_MAX_NUM_OF_FIELDS)) {
+            
+            _fieldOffsets[_numOfFields] = _sentenceLength;
+            _numOfFields++;
+            
+          }
+          
+        }
+        
+      }
+      
+      else {
+        
+        char hexDigitValue = hexCharToChar(c);
+        
+        if(hexDigitValue < 0) _parserState = GPS_PARSER_STATE_WAITING_START;
+        
+        else {
+          
+          _receivedChecksum = char(_receivedChecksum * 16 + hexDigitValue);
+          _numOfChecksumDigitsReceived++;
+          
+          if(_numOfChecksumDigitsReceived == 2) {
+            
+            _sentenceBuffer[_sentenceLength] = '\0';
+            
+            if(_receivedChecksum == _computedChecksum) validSentenceReceived = true;
+            
+            _parserState = GPS_PARSER_STATE_WAITING_START;
+            
+          }
+          
+        }
+        
+      }
+      
+    }
+    
+  }
+  
+  return validSentenceReceived;
+  
+}
+
+
+
+void UltimateGPS::resetParser() {
+  
+  _parserState = GPS_PARSER_STATE_WAITING_START;
+  
+  _sentenceLength = 0;
+  _sentenceBuffer[0] = '\0';
+  
+  _numOfFields = 0;
+  
+}
+
+
+
+char *UltimateGPS::getSentence() {
+  
+  // last sentence received by encode() : only valid right after encode() has returned true
+  
+  return _sentenceBuffer;
+  
+}
+
+
+
+char *UltimateGPS::getFieldPointer(byte fieldIndex) {
+  
+  // the field content ends with the next ',' or '*' char : a missing field points to the end of the sentence
+  
+  char *fieldPointer;
+  
+  if(fieldIndex < _numOfFields) fieldPointer = _sentenceBuffer + _fieldOffsets[fieldIndex];
+  else fieldPointer = _sentenceBuffer + _sentenceLength;
+  
+  return fieldPointer;
+  
+}
+
+
+
+boolean UltimateGPS::isFieldEmpty(byte fieldIndex) {
+  
+  char c = *getFieldPointer(fieldIndex);
+  
+  return ((c == ',') or (c == '*') or (c == '\0'));
+  
+}
+
+
+
+boolean UltimateGPS::isSentenceType(char *sentenceType) {
+  
+  // sentenceType example : "GPGGA" (talker ID + sentence formatter)
+  
+  char *fieldPointer = getFieldPointer(0);
+  
+  byte i = 0;
+  
+  while((sentenceType[i] != '\0') and (fieldPointer[i] == sentenceType[i])) i++;
+  
+  return ((sentenceType[i] == '\0') and (fieldPointer[i] == ','));
+  
+}
+
+
+
+boolean UltimateGPS::isSentenceFormatter(char *sentenceFormatter) {
+  
+  // sentenceFormatter example : "GGA" (matches "GPGGA", "GNGGA", "GLGGA"...)
+  
+  char *fieldPointer = getFieldPointer(0);
+  
+  if((_numOfFields < 2) or ((_fieldOffsets[1] - _fieldOffsets[0]) != 6)) return false;          // 2 chars talker ID + 3 chars formatter + ','
+  
+  return (strncmp(fieldPointer + 2, sentenceFormatter, 3) == 0);
+  
+}
+
+
+
+byte UltimateGPS::twoDigitsToByte(char *digits) {
+  
+  return (digits[0] - '0') * 10 + (digits[1] - '0');
+  
+}
+
+
+
+void UltimateGPS::decodeRMCSentence() {
+  
+  // field 9 : date (ddmmyy)
+  
+  char *datePointer = getFieldPointer(9);
+  
+  byte i = 0;
+  
+  while((i < 6) and (datePointer[i] >= '0') and (datePointer[i] <= '9')) i++;
+  
+  if(i == 6) {
+  
+    byte Y = twoDigitsToByte(datePointer + 4);
+      
+    if(Y < 80) {
+      
+      _currentDate_Y = Y;
+      _currentDate_M = twoDigitsToByte(datePointer + 2);
+      _currentDate_D = twoDigitsToByte(datePointer);
+
+    }
+    
+  }
+  
+}
+
+
+
+void UltimateGPS::decodeGSASentence() {
+  
+  // field 2 : fix mode (1 = no fix, 2 = 2D, 3 = 3D), fields 15 to 17 : PDOP, HDOP, VDOP
+  
+  char fixMode = *getFieldPointer(2);
+  
+  if((fixMode >= '1') and (fixMode <= '3')) fixQuality.fixMode = fixMode - '0';
+  
+  if(!isFieldEmpty(15)) fixQuality.positionDilutionOfPrecisionInHundredths = (int) parseFixedPointField(getFieldPointer(15), 2);
+  
+  if(!isFieldEmpty(17)) fixQuality.verticalDilutionOfPrecisionInHundredths = (int) parseFixedPointField(getFieldPointer(17), 2);
+  
+}
+
+
+
+void UltimateGPS::decodeGSVSentence() {
+  
+  // field 2 : message number, field 3 : satellites in view (for the constellation of the talker ID). 
+  // Only the first message of each talker is decoded
+  
+  if((*getFieldPointer(2) != '1') or (*(getFieldPointer(2) + 1) != ',') or isFieldEmpty(3)) return;
+  
+  char *talkerID = getFieldPointer(0);
+  
+  byte constellationIndex = GPS_NUM_OF_CONSTELLATIONS - 1;
+  
+  if(talkerID[0] == 'G') {
+    
+    if(talkerID[1] == 'P') constellationIndex = 0;
+    else if(talkerID[1] == 'L') constellationIndex = 1;
+    else if(talkerID[1] == 'A') constellationIndex = 2;
+    
+  }
+  
+  _numOfSatellitesInView[constellationIndex] = (byte) parseFixedPointField(getFieldPointer(3), 0);
+  
+  fixQuality.numOfSatellitesInView = 0;
+  
+  for(byte i = 0 ; i < GPS_NUM_OF_CONSTELLATIONS ; i++) fixQuality.numOfSatellitesInView += _numOfSatellitesInView[i];
+  
+}
+
+
+
+boolean UltimateGPS::decodeGGASentence(float accuracyLimit, byte minNumOfSatellites) {
+  
+  // returns true if the fix quality is good enough : the fix is then stored in position
+  
+  boolean newPositionAcquired = false;
+  
+  int horizontalDilutionOfPrecisionInHundredths = 0;
+  
+  byte numOfSatellites = (byte) parseFixedPointField(getFieldPointer(7), 0);       // field 7 : number of satellites in use
+  
+  char fixIndicator = *getFieldPointer(6);                            // field 6 : fix quality indicator
+  
+  fixQuality.numOfSatellitesInUse = numOfSatellites;
+  
+  if((fixIndicator == '1') or (fixIndicator == '2')) {
+    
+    if(timeToFirstFixInMS == 0) timeToFirstFixInMS = millis() - _powerOnMS;                 // time-to-first-fix, measured from the power on
+    
+    if(!isFieldEmpty(8)) {                                           // field 8 : horizontal dilution of precision
+     
+      horizontalDilutionOfPrecisionInHundredths = (int) parseFixedPointField(getFieldPointer(8), 2);
+      
+      fixQuality.horizontalDilutionOfPrecisionInHundredths = horizontalDilutionOfPrecisionInHundredths;
+      
+      if((horizontalDilutionOfPrecisionInHundredths > 0) and (horizontalDilutionOfPrecisionInHundredths < (accuracyLimit * 100))) newPositionAcquired = true;
+      
+    }
+    
+  }
+  
+  if(newPositionAcquired and (numOfSatellites < minNumOfSatellites)) newPositionAcquired = false;
+  
+  if(newPositionAcquired and (fixQuality.fixMode < _minFixMode)) newPositionAcquired = false;                    // fix mode of the last GSA sentence
+  
+  if(newPositionAcquired and (_pdopLimitInHundredths > 0)) {
+    
+    if((fixQuality.positionDilutionOfPrecisionInHundredths == 0) or (fixQuality.positionDilutionOfPrecisionInHundredths >= _pdopLimitInHundredths)) newPositionAcquired = false;
+    
+  }
+  
+  if(newPositionAcquired and ((getFieldPointer(2) - getFieldPointer(1)) < 7)) newPositionAcquired = false;      // field 1 : fix time (hhmmss.sss)
+  
+  if(newPositionAcquired and (_currentDate_Y == 0)) newPositionAcquired = false;       // no RMC date yet (reset by beginAcquisition()) : the fix date would be 00/00/00
+  
+  if(newPositionAcquired) {
+    
+    // fix time
+    
+    char *timePointer = getFieldPointer(1);
+    
+    position.fix_Y_utc = _currentDate_Y;
+    position.fix_M_utc = _currentDate_M;
+    position.fix_D_utc = _currentDate_D;
+    
+    position.fix_h_utc = twoDigitsToByte(timePointer);
+    position.fix_m_utc = twoDigitsToByte(timePointer + 2);
+    position.fix_s_utc = twoDigitsToByte(timePointer + 4);
+    
+    
+    // latitude (field 2 : ddmm.mmmm, field 3 : N/S)
+    
+    position.latitudeInMicroDegrees = parseCoordinateField(getFieldPointer(2));
+    
+    if(*getFieldPointer(3) == 'S') position.latitudeInMicroDegrees = -position.latitudeInMicroDegrees;
+    
+
+    // longitude (field 4 : dddmm.mmmm, field 5 : E/W)
+    
+    position.longitudeInMicroDegrees = parseCoordinateField(getFieldPointer(4));
+    
+    if(*getFieldPointer(5) == 'W') position.longitudeInMicroDegrees = -position.longitudeInMicroDegrees;
+   
+    
+    // altitudeAboveMSL (field 9)
+    
+    position.altitudeAboveMSLInCm = parseFixedPointField(getFieldPointer(9), 2);        
+    
+    position.horizontalDilutionOfPrecisionInHundredths = horizontalDilutionOfPrecisionInHundredths;
+    
+    position.numOfSatellites = numOfSatellites;
+    
+
+    if(!firstPositionAcquired) firstPositionAcquired = true;
+    
+  }
+  
+  return newPositionAcquired;
+  
+}
+
+
+
+long UltimateGPS::parseFixedPointField(char *field, byte numOfDecimals) {
+  
+  // "-12.345" with numOfDecimals = 2 -> -1234 (the extra decimals are truncated, the missing ones are padded with 0).
+  // The integer digits beyond 9 - numOfDecimals digits (malformed field) are ignored : the value never overflows 32 bits
+  
+  long value = 0;
+  
+  long integerPartLimit = 100000000L;
+  
+  for(byte i = 0 ; (i < numOfDecimals) and (integerPartLimit > 1) ; i++) integerPartLimit /= 10;
+  
+  boolean negative = false;
+  
+  byte numOfDecimalsParsed = 0;
+  
+  boolean inDecimals = false;
+  
+  if(*field == '-') {
+    
+    negative = true;
+    field++;
+    
+  }
+  
+  for( ; ((*field >= '0') and (*field <= '9')) or ((*field == '.') and !inDecimals) ; field++) {
+    
+    if(*field == '.') inDecimals = true;
+    
+    else if(!inDecimals) {
+      
+      if(value < integerPartLimit) value = value * 10 + (*field - '0');
+      
+    }
+    
+    else if(numOfDecimalsParsed < numOfDecimals) {
+      
+      value = value * 10 + (*field - '0');
+      numOfDecimalsParsed++;
+      
+    }
+    
+  }
+  
+  for( ; numOfDecimalsParsed < numOfDecimals ; numOfDecimalsParsed++) value *= 10;
+  
+  if(negative) value = -value;
+  
+  return value;
+  
+}
+
+
+
+long UltimateGPS::parseCoordinateField(char *field) {
+  
+  // "ddmm.mmmm" or "dddmm.mmmm" -> micro-degrees : the degrees and the minutes are decoded separately, so that the full
+  // resolution of the NMEA field is kept without overflowing 32 bits (the minutes are handled in millionths of minutes, and 
+  // the digits beyond "dddmm" are ignored)
+  
+  long degreesAndMinutes = 0;
+  
+  for( ; (*field >= '0') and (*field <= '9') and (degreesAndMinutes < 10000L) ; field++) degreesAndMinutes = degreesAndMinutes * 10 + (*field - '0');
+  
+  long minutesInMillionths = (degreesAndMinutes % 100) * 1000000L;
+  
+  if(*field == '.') {
+    
+    field++;
+    
+    long decimalWeight = 100000L;
+    
+    for( ; (*field >= '0') and (*field <= '9') ; field++) {
+      
+      minutesInMillionths += (*field - '0') * decimalWeight;
+      decimalWeight /= 10;
+      
+    }
+    
+  }
+  
+  return (degreesAndMinutes / 100) * 1000000L + (minutesInMillionths + 30) / 60;
+  
+}
+
+
     
 char UltimateGPS::hexCharToChar(char n) {
   
@@ -1,7 +1,7 @@
 /*
  * File : Ultimate_GPS.h
  *
- * Version : 0.8.1
+ * Version : 0.8.14
  *
  * Purpose : Ultimate GPS V3 (http://www.adafruit.com) interface library for Arduino
  *
@@ -16,6 +16,21 @@
  * History :
  *
  * - 0.8.1 : bug fixes in the acquireNewPosition() and getFieldContentFromNMEASentence() methods
+ * - 0.8.2 : incremental NMEA parser (checksum and field offsets computed on the fly, as the chars are received)
+ * - 0.8.3 : fixed-point position (micro-degrees, centimeters) decoded without atof() / float arithmetic
+ * - 0.8.4 : time / position aiding (PMTK740 / PMTK741), backup mode (PMTK225) and time-to-first-fix measurement
+ * - 0.8.5 : configure() : NMEA output mask (PMTK314), serial link baud rate (PMTK251) and update rate (PMTK220), verified with the PMTK001 acks
+ * - 0.8.6 : multi-fix acquisition (acquireAveragedPosition()) : HDOP weighted mean, outlier rejection, early exit on convergence, satellites count gate
+ * - 0.8.7 : talker-agnostic sentences dispatcher (GP, GN, GL, GA, BD...) : GGA, RMC, GSA and GSV decoders, fix mode / PDOP / VDOP acquisition criteria
+ * - 0.8.8 : bounds checks for malformed, truncated and overlong sentences (getFieldContentFromNMEASentence(), isSentenceChecksumOK(), GGA decoder), 
+ *           the library can be compiled for a host (no AVR sleep mode outside AVR targets) to replay NMEA logs
+ * - 0.8.9 : cumulative full power time (powerOnTimeInMS), from powerOn() to powerOff() / enterBackupMode()
+ * - 0.8.10 : spans tracing (see SpanTrace.h) : acquireNewPosition()
+ * - 0.8.11 : last known position persisted in EEPROM (savePosition() / restorePosition()), for the fast start of the station
+ * - 0.8.12 : the getFieldContentFromNMEASentence() and isSentenceChecksumOK() methods, unused since the incremental parser (0.8.2), are removed
+ * - 0.8.13 : a GGA fix is rejected until the date of the acquisition has been decoded from a RMC sentence
+ * - 0.8.14 : host tests (host-tests/ultimate-gps : NMEA logs replay, throughput, fuzzing) : the parseFixedPointField() and 
+ *            parseCoordinateField() results no longer overflow 32 bits with malformed fields (too many integer digits)
  * 
  */
 
@@ -34,6 +49,51 @@
 
 #define GPS_NMEA_SENTENCE_BUFFER_SIZE 101
 
+#define GPS_NMEA_MAX_NUM_OF_FIELDS 24
+
+
+#define GPS_PMTK_COMMAND_BUFFER_SIZE 80
+
+#define GPS_PMTK_ACK_TIMEOUT_IN_MS 1500
+
+
+#define GPS_NMEA_OUTPUT_GLL 0x01                          // PMTK314 output mask bits (one bit per sentence type)
+#define GPS_NMEA_OUTPUT_RMC 0x02
+#define GPS_NMEA_OUTPUT_VTG 0x04
+#define GPS_NMEA_OUTPUT_GGA 0x08
+#define GPS_NMEA_OUTPUT_GSA 0x10
+#define GPS_NMEA_OUTPUT_GSV 0x20
+
+#define GPS_NMEA_OUTPUT_DEFAULT_MASK (GPS_NMEA_OUTPUT_RMC | GPS_NMEA_OUTPUT_GGA)          // the only sentences decoded by acquireNewPosition()
+
+#define GPS_DEFAULT_UPDATE_PERIOD_IN_MS 1000
+
+
+#define GPS_AVERAGING_MAX_NUM_OF_FIXES 16
+
+#define GPS_AVERAGING_MIN_NUM_OF_FIXES 3                 // minimum number of fixes before the convergence test and the outlier rejection
+
+#define GPS_OUTLIER_REJECTION_FACTOR 3                    // fixes farther than FACTOR * median distance from the median position are rejected
+
+#define GPS_CM_PER_MICRO_DEGREE_OF_LATITUDE 11.132
+
+
+#define GPS_NUM_OF_CONSTELLATIONS 4                       // satellites in view counted per talker ID : GP, GL, GA, others (BD, GB, GQ...)
+
+
+#define GPS_FIX_MODE_UNKNOWN 0                            // no GSA sentence received since the beginning of the acquisition
+#define GPS_FIX_MODE_NO_FIX 1
+#define GPS_FIX_MODE_2D 2
+#define GPS_FIX_MODE_3D 3
+
+
+#define GPS_POSITION_EEPROM_MARKER 0x5A
+
+
+#define GPS_PARSER_STATE_WAITING_START 0
+#define GPS_PARSER_STATE_IN_SENTENCE 1
+#define GPS_PARSER_STATE_IN_CHECKSUM 2
+
 
 # define DEBUG_MODE true
 
@@ -41,10 +101,12 @@
 
 struct Position {
   
-  float latitude;                             // decimal degrees
-  float longitude;                            // decimal degrees
-  float altitudeAboveMSL;                     // meters
-  float horizontalDilutionOfPrecision;        
+  long latitudeInMicroDegrees;                          // decimal degrees * 1000000
+  long longitudeInMicroDegrees;                         // decimal degrees * 1000000
+  long altitudeAboveMSLInCm;                            // centimeters
+  int horizontalDilutionOfPrecisionInHundredths;        // HDOP * 100
+  byte numOfSatellites;                                 // satellites used for the fix
+  byte numOfAveragedFixes;                              // 1 for a single fix (see acquireAveragedPosition())
   
   byte fix_Y_utc;
   byte fix_M_utc;
@@ -53,6 +115,35 @@ struct Position {
   byte fix_m_utc;
   byte fix_s_utc;
   
+  float getLatitude() { return latitudeInMicroDegrees / 1000000.0; }                          // decimal degrees
+  float getLongitude() { return longitudeInMicroDegrees / 1000000.0; }                        // decimal degrees
+  float getAltitudeAboveMSL() { return altitudeAboveMSLInCm / 100.0; }                        // meters
+  float getHorizontalDilutionOfPrecision() { return horizontalDilutionOfPrecisionInHundredths / 100.0; }
+  
+};
+
+
+
+
+struct PositionEEPROMEntry {
+  
+  byte marker;                                          // GPS_POSITION_EEPROM_MARKER if the entry has been written at least once
+  Position position;
+  
+};
+
+
+
+
+struct FixQuality {
+  
+  byte fixMode;                                         // GPS_FIX_MODE_xxx (GSA)
+  int positionDilutionOfPrecisionInHundredths;          // PDOP * 100 (GSA), 0 if unknown
+  int horizontalDilutionOfPrecisionInHundredths;        // HDOP * 100 (GGA)
+  int verticalDilutionOfPrecisionInHundredths;          // VDOP * 100 (GSA), 0 if unknown
+  byte numOfSatellitesInUse;                            // all constellations (GGA)
+  byte numOfSatellitesInView;                           // sum of the GSV counts of all the talkers
+  
 };
 
 
@@ -60,6 +151,8 @@ struct Position {
 
 class UltimateGPS {
 
+  friend class UltimateGPSHostTest;                     // host tests : parser and decoders internals (see host-tests/ultimate-gps)
+
   public:
 
     UltimateGPS(HardwareSerial *gpsSerialConnection, byte onOffPin);
@@ -71,15 +164,52 @@ class UltimateGPS {
     boolean firstPositionAcquired;
     
     Position position;
+    
+    FixQuality fixQuality;                            // updated with each decoded GGA / GSA / GSV sentence
+    
+    unsigned long timeToFirstFixInMS;                 // 0 if no fix has been obtained during the last acquisition
+    
+    unsigned long powerOnTimeInMS;                    // cumulative time spent at full power (backup mode excluded), millis() based
         
     void powerOn();
    
     void powerOff();
+    
+    void enterBackupMode();
+    
+    boolean isInBackupMode();
         
-    void configure();
+    boolean configure();
+    
+    boolean configure(byte nmeaOutputMask, unsigned long baudRate, unsigned int updatePeriodInMS);
+    
+    void sendTimeAiding(byte year2K, byte month, byte day, byte hour, byte minute, byte second);
+    
+    void sendPositionAiding(long latitudeInMicroDegrees, long longitudeInMicroDegrees, long altitudeAboveMSLInCm, 
+                            byte year2K, byte month, byte day, byte hour, byte minute, byte second);
+    
+    void sendPMTKCommand(char *command);
+    
+    boolean sendPMTKCommandAndWaitForAck(char *command, long timeOutInMS);
+    
+    void setAcquisitionCriteria(byte minFixMode, float pdopLimit);
     
     boolean acquireNewPosition(float accuracyLimit, int timeoutInS);
     
+    boolean acquireAveragedPosition(float accuracyLimit, byte minNumOfSatellites, byte maxNumOfFixes, int averagingWindowInS, int convergenceRadiusInCm, int timeoutInS);
+    
+    void savePosition(int eepromAddress);
+    
+    boolean restorePosition(int eepromAddress);
+    
+    float getDistanceInCm(long latitude1InMicroDegrees, long longitude1InMicroDegrees, long latitude2InMicroDegrees, long longitude2InMicroDegrees);
+    
+    boolean encode(char c);
+    
+    void resetParser();
+    
+    char *getSentence();
+    
 
   private:
   
@@ -87,13 +217,83 @@ class UltimateGPS {
     
     byte _onOffPin;
     
+    unsigned long _defaultBaudRate;
+    
+    unsigned long _baudRate;
+    
     SoftwareSerial *_debugSerialConnection;
     
     boolean _debugSerialConnectionEnabled;
     
-    void getFieldContentFromNMEASentence(char *nmeaSentence, char *fieldData, byte fieldIndex);
+    boolean _inBackupMode;
+    
+    unsigned long _powerOnMS;
+    
+    boolean _fullPower;
+    
+    byte _minFixMode;
+    
+    int _pdopLimitInHundredths;
+    
+    byte _numOfSatellitesInView[GPS_NUM_OF_CONSTELLATIONS];
+    
+    char _sentenceBuffer[GPS_NMEA_SENTENCE_BUFFER_SIZE];
+    
+    byte _sentenceLength;
+    
+    byte _fieldOffsets[GPS_NMEA_MAX_NUM_OF_FIELDS];
+    
+    byte _numOfFields;
+    
+    byte _parserState;
+    
+    char _computedChecksum;
+    
+    char _receivedChecksum;
+    
+    byte _numOfChecksumDigitsReceived;
+    
+    byte _currentDate_Y;
+    byte _currentDate_M;
+    byte _currentDate_D;
+    
+    char *getFieldPointer(byte fieldIndex);
+    
+    boolean isFieldEmpty(byte fieldIndex);
+    
+    boolean isSentenceType(char *sentenceType);
+    
+    boolean isSentenceFormatter(char *sentenceFormatter);
+    
+    boolean decodeSentence(float accuracyLimit, byte minNumOfSatellites);
+    
+    void setSerialBaudRate(unsigned long baudRate);
+    
+    byte twoDigitsToByte(char *digits);
+    
+    long parseFixedPointField(char *field, byte numOfDecimals);
+    
+    long parseCoordinateField(char *field);
+    
+    void appendNumber(char *buffer, long value, byte minNumOfDigits);
+    
+    void appendFixedPoint(char *buffer, long value, byte numOfDecimals);
+    
+    void appendDateTime(char *buffer, byte year2K, byte month, byte day, byte hour, byte minute, byte second);
+    
+    void decodeRMCSentence();
+    
+    void decodeGSASentence();
+    
+    void decodeGSVSentence();
+    
+    boolean decodeGGASentence(float accuracyLimit, byte minNumOfSatellites);
+    
+    boolean waitForNextFix(float accuracyLimit, byte minNumOfSatellites, unsigned long startMS, unsigned long timeoutInMS);
+    
+    void beginAcquisition();
     
-    boolean isSentenceChecksumOK(char *sentence);
+    long getMedian(long *values, long *sortedValues, byte numOfValues);
     
     char hexCharToChar(char n);
 